@@ -19,14 +19,35 @@
  * - <tt>time build-myplatform/tests/bench_read_safe</tt> - this is sigsafe's
  *   handling. In theory, it should be very slightly slower than the libc's.
  *   In practice, it is actually slightly faster in some cases! (This implies
- *   a suboptimal libc.) Let me know if it is significantly slower.  (It may
- *   be so on the Pentium IV, because I have yet to implement
- *   <tt>SYSENTER</tt> support.)
+ *   a suboptimal libc.) Let me know if it is significantly slower. (On
+ *   Linux/x86, the wrappers enter the kernel through the vDSO's
+ *   <tt>__kernel_vsyscall</tt>, so they get <tt>SYSENTER</tt> where the
+ *   processor has it, just like the libc. To compare on an x86_64 machine,
+ *   build with <tt>CC="gcc -m32"</tt> and a 32-bit libc installed.)
  * - <tt>time build-platform/tests/bench_read_select</tt> - this is a test
  *   with every read preceded by a <tt>select</tt>, as is necessary in some
  *   cases with the self-pipe trick commonly used as an alternative to
  *   sigsafe. It should be about half the speed.
  *
+ * On Linux/x86 and Linux/x86_64, the multi-threaded library normally finds
+ * each thread's data with a call to <tt>pthread_getspecific</tt> in every
+ * wrapper. Building with <tt>scons tls=1</tt> keeps it in an initial-exec
+ * <tt>__thread</tt> pointer instead, so the wrapper needs a single
+ * <tt>%fs</tt>- or <tt>%gs</tt>-relative load and saves no registers. Compare
+ * <tt>bench_read_safe</tt> from a <tt>tls=0</tt> and a <tt>tls=1</tt> build
+ * to see the difference on your machine; it is all user time. The catch is
+ * that initial-exec TLS can't be used from a library loaded with
+ * <tt>dlopen()</tt>, which is why it is not the default.
+ *
+ * On Linux/x86_64, <tt>sigsafe_inline.h</tt> goes further: its
+ * <tt>sigsafe_read_inline()</tt> and friends expand the check and the
+ * <tt>syscall</tt> instruction right into the caller, with no call or
+ * register saving at all. Each expansion records its own jump region in a
+ * <tt>sigsafe_jmptab</tt> linker section that the signal handler searches
+ * along with the library's. <tt>bench_read_inline</tt> measures it. They are
+ * only inline in single-threaded or <tt>tls=1</tt> code, since keyed
+ * thread-specific data would need a call anyway.
+ *
  * The real-world benchmark will likely be Apache. I've made a patch that
  * eliminates a need to use <tt>select</tt> before <tt>read</tt> and
  * <tt>write</tt> for socket timeouts. There are actually no signals involved,
@@ -34,4 +55,23 @@
  * with high system call overhead (notably Darwin), it is noticeably faster.
  * Unfortunately, I've run into hardware problems while benchmarking. Stay
  * tuned...
+ *
+ * On Linux, sigsafe_set_deadline() packages that pattern up. Each thread gets
+ * its own POSIX timer aimed at it with <tt>SIGEV_THREAD_ID</tt>, so unlike
+ * <tt>setitimer</tt> it works with any number of threads. The timer is
+ * created once and then only rearmed, one system call per deadline instead of
+ * a <tt>select</tt> per operation.
+ *
+ * Event-driven programs that would use the self-pipe trick can use the
+ * @ref sigsafe_reactor "reactor" instead. It waits in sigsafe_epoll_wait()
+ * (or sigsafe_poll() or sigsafe_select()), which a signal cuts short
+ * even if it arrives just before the wait. There is no pipe to write in the
+ * handler, to read in the loop, or to watch alongside everything else, so an
+ * iteration costs the one wait and nothing more.
+ *
+ * Thread pools with blocking tasks usually cancel by closing the task's
+ * descriptor or by polling a flag between short timeouts. The
+ * @ref sigsafe_pool "pool" signals the one worker running the task instead,
+ * so its blocking call returns <tt>-EINTR</tt> in microseconds without any
+ * timeouts; <tt>tests/bench_pool</tt> measures it.
  */
@@ -17,8 +17,12 @@
  *   _sigsafe_XXX_jmpto. (It should not be in that region.) Look at the other
  *   platforms for examples.
  *
- * - the signal handler. It should adjust the instruction pointer inside the
- *   context argument as mentioned above. Then return to userspace. On all the
+ * - the signal handler. It should pass the instruction pointer from the
+ *   context argument to <tt>sigsafe_lookup_jmp_()</tt> and, if that finds a
+ *   jump region, replace it with the region's <tt>jmpto</tt>. Then return to
+ *   userspace. (The lookup is shared code; it sorts the regions once at
+ *   initialization so it can reject addresses outside every wrapper with a
+ *   single range check and find the rest with a binary search.) On all the
  *   previous platforms, just modifying the context and returning normally is
  *   sufficient. You might find instead:
  *
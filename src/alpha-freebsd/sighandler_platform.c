@@ -15,16 +15,14 @@
 HIDDEN_DEC void
 sigsafe_handler_for_platform_(ucontext_t *ctx)
 {
-    struct sigsafe_syscall_ *s;
+    const struct sigsafe_jmp_ *j;
     void *pc;
     pc = (void*) ctx->uc_mcontext.mc_regs[R_PC];
-    for (s = sigsafe_syscalls_; s->minjmp != NULL; s++) {
-        if (s->minjmp <= pc && pc <= s->maxjmp) {
+    j = sigsafe_lookup_jmp_(pc);
+    if (j != NULL) {
 #ifdef SIGSAFE_DEBUG_JUMP
-            write(2, "[J]", 3);
+        write(2, "[J]", 3);
 #endif
-            ctx->uc_mcontext.mc_regs[R_PC] = (long) s->jmpto;
-            return;
-        }
+        ctx->uc_mcontext.mc_regs[R_PC] = (long) j->jmpto;
     }
 }
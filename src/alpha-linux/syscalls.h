@@ -8,6 +8,9 @@
  */
 
 SYSCALL(accept, 2)
+#ifdef SIGSAFE_HAVE_CLOCK_NANOSLEEP
+SYSCALL(clock_nanosleep, 4)
+#endif
 SYSCALL(connect, 3)
 #ifdef SIGSAFE_HAVE_EPOLL
 SYSCALL(epoll_wait, 4)
@@ -23,9 +26,15 @@ SYSCALL(recvmsg, 3)
 SYSCALL(recvfrom, 6)
 SYSCALL(select, 5)
 SYSCALL(send, 4)
+SYSCALL(sendfile, 4)
 SYSCALL(sendmsg, 3)
 SYSCALL(sendto, 6)
 SYSCALL(sigsuspend, 1)
+#ifdef SIGSAFE_HAVE_SPLICE
+SYSCALL(splice, 6)
+SYSCALL(tee, 4)
+SYSCALL(vmsplice, 4)
+#endif
 SYSCALL(wait4, 4)
 SYSCALL(write, 3)
 SYSCALL(writev, 3)
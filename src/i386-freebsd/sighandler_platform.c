@@ -13,16 +13,14 @@
 
 HIDDEN_DEF void
 sigsafe_handler_for_platform_(ucontext_t *ctx) {
-    struct sigsafe_syscall_ *s;
+    const struct sigsafe_jmp_ *j;
     void *eip;
     eip = (void*) ctx->uc_mcontext.mc_eip;
-    for (s = sigsafe_syscalls_; s->minjmp != NULL; s++) {
-        if (s->minjmp <= eip && eip <= s->maxjmp) {
+    j = sigsafe_lookup_jmp_(eip);
+    if (j != NULL) {
 #ifdef SIGSAFE_DEBUG_JUMP
-            write(2, "[J]", 3);
+        write(2, "[J]", 3);
 #endif
-            ctx->uc_mcontext.mc_eip = (int) s->jmpto;
-            return;
-        }
+        ctx->uc_mcontext.mc_eip = (int) j->jmpto;
     }
 }
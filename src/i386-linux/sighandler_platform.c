@@ -11,19 +11,168 @@
 #include "sigsafe_internal.h"
 #include <ucontext.h>
 #include <unistd.h>
+#ifdef __GLIBC__
+#include <sys/auxv.h>
+#endif
+
+/** Length of the wrappers' "call *sigsafe_vsyscall_" (ff 15 + abs32). */
+#define CALL_SIZE 6
+
+/** The most registers a trampoline may push before entering the kernel. */
+#define MAX_PUSHES 4
+
+/** How far into __kernel_vsyscall to look for the kernel entry. */
+#define MAX_SCAN 32
+
+/**
+ * A kernel entry trampoline the wrappers may call through
+ * <tt>sigsafe_vsyscall_</tt>. Up to and including <tt>entry</tt>, the
+ * trampoline has done nothing but push registers; it has not yet entered the
+ * kernel, or the kernel will restart the system call at <tt>entry</tt>.
+ */
+struct trampoline {
+    unsigned char *start;
+    unsigned char *entry;   /**< address of the int $0x80 */
+    int npushes;
+    struct {
+        unsigned char *at;  /**< address of the push instruction */
+        int reg;            /**< REG_xxx index of the register pushed */
+    } pushes[MAX_PUSHES];
+};
+
+INTERNAL_DEC void sigsafe_int80_(void);
+INTERNAL_DEC void *sigsafe_vsyscall_;
+
+/* The int $0x80 one; the vDSO's, if find_vsyscall fills it in; the end. */
+static struct trampoline trampolines[] = {
+    { (unsigned char*) sigsafe_int80_, (unsigned char*) sigsafe_int80_, 0 },
+    { NULL, NULL, 0 },
+    { NULL, NULL, 0 }
+};
+
+/** REG_xxx indexes by the register number in a 0x50+r push opcode. */
+static const int push_regs[8] = {
+    REG_EAX, REG_ECX, REG_EDX, REG_EBX, -1 /* %esp */, REG_EBP, REG_ESI,
+    REG_EDI
+};
+
+/**
+ * Learns the layout of the vDSO's __kernel_vsyscall and, if it looks like
+ * something we can unwind, switches the wrappers over to it.
+ * The prologue must consist only of register pushes, moves into %ebp, and
+ * no-ops, followed by sysenter or syscall and then the int $0x80 the kernel
+ * uses as its restart point. Anything else and we keep using int $0x80
+ * directly, which is always correct, just slower.
+ */
+static void __attribute__ ((constructor))
+find_vsyscall(void)
+{
+    struct trampoline *t = &trampolines[1];
+    unsigned char *p = NULL;
+    int i = 0;
+
+#if defined(__GLIBC__) && defined(AT_SYSINFO)
+    p = (unsigned char*) getauxval(AT_SYSINFO);
+#endif
+    if (p == NULL) {
+        return;
+    }
+    t->npushes = 0;
+    while (i < MAX_SCAN) {
+        unsigned char c = p[i];
+        if (0x50 <= c && c <= 0x57 && push_regs[c - 0x50] != -1) {
+            if (t->npushes == MAX_PUSHES) {
+                return;
+            }
+            t->pushes[t->npushes].at = &p[i];
+            t->pushes[t->npushes].reg = push_regs[c - 0x50];
+            t->npushes++;
+            i++;
+        } else if (c == 0x89 && (p[i+1] == 0xe5 || p[i+1] == 0xcd)) {
+            i += 2;         /* movl %esp,%ebp or movl %ecx,%ebp */
+        } else if (c == 0x90) {
+            i++;            /* nop */
+        } else if (c == 0x66 && p[i+1] == 0x90) {
+            i += 2;         /* xchg %ax,%ax */
+        } else if (c == 0x0f && p[i+1] == 0x1f) {
+            /* nopl with a modrm, optionally a sib, and a displacement */
+            unsigned char modrm = p[i+2];
+            i += 3;
+            if ((modrm & 0x07) == 0x04 && (modrm & 0xc0) != 0xc0) {
+                i++;
+            }
+            if ((modrm & 0xc0) == 0x40) {
+                i += 1;
+            } else if ((modrm & 0xc0) == 0x80) {
+                i += 4;
+            }
+        } else if (c == 0x66 && p[i+1] == 0x0f && p[i+2] == 0x1f) {
+            i++;            /* operand-size prefix on the above */
+        } else if (c == 0x0f && (p[i+1] == 0x34 || p[i+1] == 0x05)) {
+            i += 2;         /* sysenter or syscall */
+            if (p[i] != 0xcd || p[i+1] != 0x80) {
+                return;
+            }
+        } else if (c == 0xcd && p[i+1] == 0x80) {
+            t->start = p;
+            t->entry = &p[i];
+            sigsafe_vsyscall_ = p;
+            return;
+        } else {
+            return;
+        }
+    }
+}
+
+/**
+ * Handles a signal that arrived inside a trampoline, before the kernel was
+ * entered. If the trampoline was called from a wrapper's maxjmp, this pops
+ * the pushed registers and the return address back off the stack and
+ * returns the wrapper's jump region. Otherwise (say, glibc calling
+ * __kernel_vsyscall itself), it leaves the context alone and returns NULL.
+ */
+static const struct sigsafe_jmp_ *
+unwind_trampoline(ucontext_t *ctx, unsigned char *eip)
+{
+    struct trampoline *t;
+
+    for (t = trampolines; t->start != NULL; t++) {
+        if (t->start <= eip && eip <= t->entry) {
+            const struct sigsafe_jmp_ *j;
+            greg_t *gregs = ctx->uc_mcontext.gregs;
+            unsigned long *sp = (unsigned long*) gregs[REG_ESP];
+            unsigned char *ret;
+            int n, i;
+
+            for (n = 0; n < t->npushes && t->pushes[n].at < eip; n++) ;
+            ret = (unsigned char*) sp[n];
+            j = sigsafe_lookup_jmp_(ret - CALL_SIZE);
+            if (j == NULL || j->maxjmp != ret - CALL_SIZE) {
+                return NULL;
+            }
+            for (i = 0; i < n; i++) {
+                gregs[t->pushes[i].reg] = sp[n - 1 - i];
+            }
+            gregs[REG_ESP] = (greg_t) (sp + n + 1);
+            return j;
+        }
+    }
+    return NULL;
+}
 
 HIDDEN_DEF void
 sigsafe_handler_for_platform_(ucontext_t *ctx) {
-    struct sigsafe_syscall_ *s;
+    const struct sigsafe_jmp_ *j;
     void *eip;
     eip = (void*) ctx->uc_mcontext.gregs[REG_EIP];
-    for (s = sigsafe_syscalls_; s->minjmp != NULL; s++) {
-        if (s->minjmp <= eip && eip <= s->maxjmp) {
+    j = sigsafe_lookup_jmp_(eip);
+    if (j == NULL) {
+        j = unwind_trampoline(ctx, eip);
+    }
+    if (j != NULL) {
 #ifdef SIGSAFE_DEBUG_JUMP
-            write(2, "[J]", 3);
+        write(2, "[J]", 3);
 #endif
-            ctx->uc_mcontext.gregs[REG_EIP] = (int) s->jmpto;
-            return;
-        }
+        ctx->uc_mcontext.gregs[REG_EIP] = (int) j->jmpto;
     }
 }
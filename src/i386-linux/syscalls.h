@@ -8,25 +8,83 @@
  */
 
 /* accept goes through socketcall */
+#ifdef SIGSAFE_HAVE_CLOCK_NANOSLEEP
+SYSCALL(clock_nanosleep, 4)
+#endif
 /* connect goes through socketcall */
 #ifdef SIGSAFE_HAVE_EPOLL
 SYSCALL(epoll_wait, 4)
 #endif
+#ifdef SIGSAFE_HAVE_EPOLL_PWAIT2
+/* Wrapped in sigsafe_pwait.c. The number is the same on all platforms. */
+#ifndef __NR_epoll_pwait2
+#define __NR_epoll_pwait2 441
+#endif
+#define __NR_raw_epoll_pwait2 __NR_epoll_pwait2
+SYSCALL(raw_epoll_pwait2, 6)
+#endif
+#ifdef SIGSAFE_HAVE_IO_URING
+SYSCALL(io_uring_enter, 6)
+#endif
 SYSCALL(nanosleep, 3)
 SYSCALL(open, 3)
 SYSCALL(pause, 0)
 SYSCALL(poll, 3)
+#ifdef SIGSAFE_HAVE_PPOLL
+/* ppoll and pselect6 are wrapped in sigsafe_pwait.c. */
+#define __NR_raw_ppoll __NR_ppoll
+SYSCALL(raw_ppoll, 5)
+#endif
+/*
+ * The 64-bit offsets take two stack slots, low word first, just as the
+ * kernel wants them in two registers; so these take one more "argument".
+ */
+#define __NR_pread __NR_pread64
+SYSCALL(pread, 5)
+#ifdef SIGSAFE_HAVE_PREADV
+SYSCALL(preadv, 5)
+#endif
+#ifdef SIGSAFE_HAVE_PREADV2
+SYSCALL(preadv2, 6)
+#endif
+#ifdef SIGSAFE_HAVE_PSELECT
+#define __NR_raw_pselect6 __NR_pselect6
+SYSCALL(raw_pselect6, 6)
+#endif
+#define __NR_pwrite __NR_pwrite64
+SYSCALL(pwrite, 5)
+#ifdef SIGSAFE_HAVE_PREADV
+SYSCALL(pwritev, 5)
+#endif
+#ifdef SIGSAFE_HAVE_PREADV2
+SYSCALL(pwritev2, 6)
+#endif
 SYSCALL(read, 3)
 SYSCALL(readv, 3)
 /* recv goes through socketcall */
 /* recvfrom goes through socketcall */
 /* recvmsg goes through socketcall */
+#ifdef SIGSAFE_HAVE_MMSG
+SYSCALL(recvmmsg, 5) /* direct; not through socketcall */
+#endif
 SYSCALL(select, 5)
 /* send goes through socketcall */
 /* sendmsg goes through socketcall */
+#ifdef SIGSAFE_HAVE_MMSG
+SYSCALL(sendmmsg, 4) /* direct; not through socketcall */
+#endif
 /* sendto goes through socketcall */
+/* the original sendfile takes a 32-bit offset */
+#undef __NR_sendfile
+#define __NR_sendfile __NR_sendfile64
+SYSCALL(sendfile, 4)
 SYSCALL(sigsuspend, 1)
 SYSCALL(socketcall, 2)
+#ifdef SIGSAFE_HAVE_SPLICE
+SYSCALL(splice, 6)
+SYSCALL(tee, 4)
+SYSCALL(vmsplice, 4)
+#endif
 SYSCALL(write, 3)
 SYSCALL(writev, 3)
 SYSCALL(wait4, 4)
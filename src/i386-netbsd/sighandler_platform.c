@@ -13,16 +13,14 @@
 
 HIDDEN_DEF void
 sigsafe_handler_for_platform_(struct sigcontext *ctx) {
-    struct sigsafe_syscall_ *s;
+    const struct sigsafe_jmp_ *j;
     void *eip;
     eip = (void*) ctx->sc_eip;
-    for (s = sigsafe_syscalls_; s->minjmp != NULL; s++) {
-        if (s->minjmp <= eip && eip <= s->maxjmp) {
+    j = sigsafe_lookup_jmp_(eip);
+    if (j != NULL) {
 #ifdef SIGSAFE_DEBUG_JUMP
-            write(2, "[J]", 3);
+        write(2, "[J]", 3);
 #endif
-            ctx->sc_eip = (long) s->jmpto;
-            return;
-        }
+        ctx->sc_eip = (long) j->jmpto;
     }
 }
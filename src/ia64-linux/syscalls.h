@@ -8,6 +8,9 @@
  */
 
 SYSCALL(accept, 3)
+#ifdef SIGSAFE_HAVE_CLOCK_NANOSLEEP
+SYSCALL(clock_nanosleep, 4)
+#endif
 SYSCALL(connect, 3)
 #ifdef SIGSAFE_HAVE_EPOLL
 SYSCALL(epoll_wait, 4)
@@ -24,8 +27,14 @@ SYSCALL(recvmsg, 3)
 SYSCALL(select, 5)
 SYSCALL(send, 4)
 SYSCALL(sendto, 6)
+SYSCALL(sendfile, 4)
 SYSCALL(sendmsg, 3)
 SYSCALL(sigsuspend, 1)
+#ifdef SIGSAFE_HAVE_SPLICE
+SYSCALL(splice, 6)
+SYSCALL(tee, 4)
+SYSCALL(vmsplice, 4)
+#endif
 SYSCALL(write, 3)
 SYSCALL(writev, 3)
 SYSCALL(wait4, 4)
@@ -14,23 +14,194 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#if defined(SIGSAFE_HAVE_DEADLINE) || defined(SIGSAFE_HAVE_INTERRUPT)
+#include <sys/syscall.h>
+#endif
+#ifdef SIGSAFE_HAVE_DEADLINE
+
+/* Older C libraries don't name the thread id of a SIGEV_THREAD_ID sigevent. */
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
 
 #ifdef _THREAD_SAFE
 INTERNAL_DEF pthread_key_t sigsafe_key_ = 0;
 static pthread_once_t sigsafe_once = PTHREAD_ONCE_INIT;
+#ifdef SIGSAFE_HAVE_TLS
+/* Not internal: sigsafe_inline.h reads it directly. */
+__thread struct sigsafe_tsd_* sigsafe_data_
+        __attribute__ ((tls_model ("initial-exec"))) = 0;
+#endif
 #else
 INTERNAL_DEF struct sigsafe_tsd_* sigsafe_data_ = 0;
+
+/*
+ * For sigsafe_inline.h. The wrappers address sigsafe_data_ directly, so it
+ * can't be exported itself; a copy relocation of this is harmless.
+ */
+struct sigsafe_tsd_ ** const sigsafe_data_addr_ = &sigsafe_data_;
 static int sigsafe_inited;
 #endif
 
 static sigsafe_user_handler_t user_handlers[SIGSAFE_SIGMAX];
 
+#ifdef SIGSAFE_HAVE_INTERRUPT
+INTERNAL_DEF struct sigsafe_thread_ * volatile sigsafe_threads_;
+
+INTERNAL_DEF int sigsafe_interrupt_signum_;
+
+/*
+ * Signals sigsafe_route_signal has routed, and those among them which go to
+ * every owner rather than the first, in the layout of sigsafe_tsd_::pending.
+ */
+static volatile unsigned long routed_mask[SIGSAFE_PENDING_WORDS];
+static volatile unsigned long routed_all_mask[SIGSAFE_PENDING_WORDS];
+
+#define SIGBIT_WORD(signum) (((signum) - 1) / SIGSAFE_PENDING_BITS)
+#define SIGBIT(signum)      (1UL << (((signum) - 1) % SIGSAFE_PENDING_BITS))
+#define SIGBIT_TEST(mask, signum) ((mask)[SIGBIT_WORD(signum)] & SIGBIT(signum))
+
+/** Allocates a registry entry for tid (0 for a free one), or NULL. */
+static struct sigsafe_thread_ *
+new_thread(pid_t tid)
+{
+    struct sigsafe_thread_ *t;
+
+    if (posix_memalign((void**) &t, sizeof(struct sigsafe_thread_),
+                       sizeof(struct sigsafe_thread_)) != 0) {
+        return NULL;
+    }
+    memset(t, 0, sizeof(*t));
+    t->tid = tid;
+    return t;
+}
+
+/** Adds a new entry to the registry. */
+static void
+push_thread(struct sigsafe_thread_ *t)
+{
+    t->next = sigsafe_threads_;
+    while (!__atomic_compare_exchange_n(&sigsafe_threads_, &t->next, t, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) ;
+}
+
+/**
+ * Gives the calling thread a registry entry, reusing a free one if
+ * possible. Lock-free, so it never blocks sigsafe_interrupt_all.
+ * @param grow allocate a new entry if none is free
+ * @return the entry, or NULL if out of memory or (without grow) entries.
+ */
+static struct sigsafe_thread_ *
+register_thread(int grow)
+{
+    pid_t tid = syscall(SYS_gettid);
+    struct sigsafe_thread_ *t;
+
+    for (t = sigsafe_threads_; t != NULL; t = t->next) {
+        pid_t expected = 0;
+        if (t->tid == 0
+            && __atomic_compare_exchange_n(&t->tid, &expected, tid, 0,
+                                           __ATOMIC_ACQ_REL,
+                                           __ATOMIC_RELAXED)) {
+            return t;
+        }
+    }
+    if (!grow) {
+        return NULL;
+    }
+    t = new_thread(tid);
+    if (t != NULL) {
+        push_thread(t);
+    }
+    return t;
+}
+#endif
+
+/*
+ * Handlers run by sigsafe_dispatch_pending, and a mask in the layout of
+ * sigsafe_tsd_::pending of the signals that have them.
+ */
+static sigsafe_deferred_handler_t deferred_handlers[SIGSAFE_SIGMAX];
+static volatile unsigned long deferred_mask[SIGSAFE_PENDING_WORDS];
+
+#ifdef SIGSAFE_HAVE_INTERRUPT
+/**
+ * Forwards a process-directed signal which landed on a thread that doesn't
+ * own it to the thread(s) that do. rt_tgsigqueueinfo passes the original
+ * siginfo along where it can, so a sigqueue() value survives. The kernel
+ * only lets a thread forward user-space codes (negative ones, other than
+ * SI_TKILL) to another thread, though, so kill() and kernel-generated
+ * signals go on by plain tgkill. Async signal-safe.
+ * @return non-zero if some owner took the signal.
+ */
+static int
+forward_signal(int signum, siginfo_t *siginfo)
+{
+    struct sigsafe_thread_ *t;
+    int saved_errno = errno;
+    int all = SIGBIT_TEST(routed_all_mask, signum) != 0;
+    pid_t pid = getpid();
+    int n = 0;
+
+    for (t = __atomic_load_n(&sigsafe_threads_, __ATOMIC_ACQUIRE); t != NULL;
+         t = t->next) {
+        pid_t tid = __atomic_load_n(&t->tid, __ATOMIC_ACQUIRE);
+        if (tid != 0 && SIGBIT_TEST(t->owned, signum)
+            && ((siginfo->si_code < 0
+                 && syscall(SYS_rt_tgsigqueueinfo, pid, tid, signum,
+                            siginfo) == 0)
+                || syscall(SYS_tgkill, pid, tid, signum) == 0)) {
+            n++;
+            if (!all) {
+                break;
+            }
+        }
+    }
+    errno = saved_errno;
+    return n;
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_DEADLINE
+/** The signal deadline timers raise; 0 until chosen. */
+static int deadline_signum;
+
+static long long
+timespec_ns(const struct timespec *ts)
+{
+    return (long long) ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+/**
+ * Returns non-zero if <tt>tsd</tt>'s armed deadline has passed. A timer
+ * signal that was already queued when the deadline was moved or cleared
+ * fails this test. Async signal-safe.
+ */
+static int
+deadline_passed(const struct sigsafe_tsd_ *tsd)
+{
+    struct timespec now;
+    long long deadline_ns = __atomic_load_n(&tsd->deadline_ns,
+                                            __ATOMIC_RELAXED);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return deadline_ns != 0 && timespec_ns(&now) >= deadline_ns;
+}
+#endif
+
 #define SYSCALL(name, args) \
         INTERNAL_DEC void sigsafe_##name##_minjmp_(void); \
         INTERNAL_DEC void sigsafe_##name##_maxjmp_(void); \
         INTERNAL_DEC void sigsafe_##name##_jmpto_ (void);
 #define MACH_SYSCALL(name, args) SYSCALL(name, args)
 #include "syscalls.h"
+#ifdef SIGSAFE_HAVE_SYSCALL
+SYSCALL(syscall, 6) /* hand-written generic entry point */
+SYSCALL(batch, 2)   /* hand-written loop over sigsafe_ops */
+#endif
 #undef SYSCALL
 
 #define SYSCALL(name, args) \
@@ -39,11 +210,78 @@ static sigsafe_user_handler_t user_handlers[SIGSAFE_SIGMAX];
           sigsafe_##name##_jmpto_ },
 INTERNAL_DEF struct sigsafe_syscall_ sigsafe_syscalls_[] = {
 #include "syscalls.h"
+#ifdef SIGSAFE_HAVE_SYSCALL
+SYSCALL(syscall, 6)
+SYSCALL(batch, 2)
+#endif
     { NULL, NULL, NULL }
 };
 #undef SYSCALL
 #undef MACH_SYSCALL
 
+#define NUM_SYSCALLS \
+        (sizeof(sigsafe_syscalls_)/sizeof(sigsafe_syscalls_[0]) - 1)
+
+/*
+ * sigsafe_syscalls_, resolved and sorted by address at initialization, plus
+ * the bounds of the whole lot. Most signals arrive outside any wrapper, so
+ * they are rejected without looking at the table at all.
+ */
+static struct sigsafe_jmp_ jmps_by_addr[NUM_SYSCALLS];
+static void *jmps_lo, *jmps_hi;
+
+/*
+ * Jump tables registered by modules using the inline wrappers of
+ * sigsafe_inline.h, and regions registered with sigsafe_register_region.
+ * Nodes are pushed on the front and never removed, so the signal handler can
+ * walk the list at any time. The latter may be registered from any thread,
+ * so pushes use compare-and-swap.
+ */
+struct jmptab {
+    struct sigsafe_jmp_ *jmps;
+    size_t n;
+    void *lo, *hi;
+    struct jmptab *next;
+};
+static struct jmptab * volatile jmptabs;
+
+/** Keeps the compiler from moving memory accesses across this point. */
+#ifdef __GNUC__
+#define COMPILER_BARRIER() __asm__ __volatile__ ("" : : : "memory")
+#else
+#define COMPILER_BARRIER()
+#endif
+
+/** Appends a signal to the thread's ring, if it has one. Async signal-safe. */
+static void
+#ifdef SIGSAFE_NO_SIGINFO
+queue_siginfo(struct sigsafe_siginfo_queue_ *q, int signum, int code)
+#else
+queue_siginfo(struct sigsafe_siginfo_queue_ *q, int signum,
+              const siginfo_t *siginfo)
+#endif
+{
+    struct sigsafe_siginfo *e;
+    unsigned int tail = q->tail;
+
+    if (tail - q->head > q->mask) {
+        q->dropped++;
+        return;
+    }
+    e = &q->entries[tail & q->mask];
+    e->signo = signum;
+#ifdef SIGSAFE_NO_SIGINFO
+    e->code = code;
+    memset(&e->value, 0, sizeof(e->value));
+    e->pid = 0;
+#else
+    e->code = siginfo->si_code;
+    e->value = siginfo->si_value;
+    e->pid = siginfo->si_pid;
+#endif
+    q->tail = tail + 1;
+}
+
 static void
 #ifdef SIGSAFE_NO_SIGINFO
 sighandler(int signum, int code, struct sigcontext *ctx) {
@@ -51,14 +289,31 @@ sighandler(int signum, int code, struct sigcontext *ctx) {
 sighandler(int signum, siginfo_t *siginfo, ucontext_t *ctx)
 #endif
 {
-#ifdef _THREAD_SAFE
+#ifdef SIGSAFE_TSD_KEY
     struct sigsafe_tsd_ *sigsafe_data_ = pthread_getspecific(sigsafe_key_);
 #endif
     assert(0 < signum && signum <= SIGSAFE_SIGMAX);
 #ifdef SIGSAFE_DEBUG_SIGNAL
     write(2, "[S]", 3);
+#endif
+#ifdef SIGSAFE_HAVE_INTERRUPT
+    /* Signals sent to this thread in particular are never routed. */
+    if (SIGBIT_TEST(routed_mask, signum) && siginfo->si_code != SI_TKILL
+        && (sigsafe_data_ == NULL
+            || !SIGBIT_TEST(sigsafe_data_->thread->owned, signum))
+        && forward_signal(signum, siginfo)) {
+        return;
+    }
 #endif
     if (sigsafe_data_ != NULL) {
+#ifdef SIGSAFE_HAVE_DEADLINE
+        if (signum == deadline_signum && siginfo->si_code == SI_TIMER) {
+            if (!deadline_passed(sigsafe_data_)) {
+                return; /* left over from an earlier deadline */
+            }
+            sigsafe_data_->deadline_expired = 1;
+        }
+#endif
         if (user_handlers[signum - 1] != NULL) {
 #ifdef SIGSAFE_NO_SIGINFO
             user_handlers[signum - 1](signum, code, ctx,
@@ -68,20 +323,389 @@ sighandler(int signum, siginfo_t *siginfo, ucontext_t *ctx)
                                       sigsafe_data_->user_data);
 #endif
         }
+        if (sigsafe_data_->queue != NULL) {
+#ifdef SIGSAFE_NO_SIGINFO
+            queue_siginfo(sigsafe_data_->queue, signum, code);
+#else
+            queue_siginfo(sigsafe_data_->queue, signum, siginfo);
+#endif
+        }
+        sigsafe_data_->counts[signum - 1]++;
+        sigsafe_data_->pending[(signum - 1) / SIGSAFE_PENDING_BITS] |=
+                1UL << ((signum - 1) % SIGSAFE_PENDING_BITS);
         sigsafe_data_->signal_received = 1;
         sigsafe_handler_for_platform_(ctx);
     }
 }
 
+HIDDEN_DEF const struct sigsafe_jmp_ *
+sigsafe_search_jmp_(const struct sigsafe_jmp_ *jmps, size_t n, void *ip)
+{
+    size_t lo = 0, hi = n;
+
+    /* Find the first region starting after ip... */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (jmps[mid].minjmp <= ip) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    /* ...then the one before it is the only candidate. */
+    if (lo > 0 && ip <= jmps[lo - 1].maxjmp) {
+        return &jmps[lo - 1];
+    }
+    return NULL;
+}
+
+HIDDEN_DEF const struct sigsafe_jmp_ *
+sigsafe_lookup_jmp_(void *ip)
+{
+    const struct sigsafe_jmp_ *j;
+    struct jmptab *t;
+
+    if (jmps_lo <= ip && ip <= jmps_hi
+        && (j = sigsafe_search_jmp_(jmps_by_addr, NUM_SYSCALLS, ip)) != NULL) {
+        return j;
+    }
+    for (t = jmptabs; t != NULL; t = t->next) {
+        if (t->lo <= ip && ip <= t->hi
+            && (j = sigsafe_search_jmp_(t->jmps, t->n, ip)) != NULL) {
+            return j;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Inserts r into the sorted jmps[0..n-1].
+ * Tables are usually in address order already, but nothing guarantees it,
+ * so callers build them with this insertion sort.
+ */
+static void
+insert_jmp(struct sigsafe_jmp_ *jmps, size_t n, struct sigsafe_jmp_ r)
+{
+    size_t j;
+
+    for (j = n; j > 0 && r.minjmp < jmps[j - 1].minjmp; j--) {
+        jmps[j] = jmps[j - 1];
+    }
+    jmps[j] = r;
+}
+
+/**
+ * Fills jmps_by_addr, jmps_lo, and jmps_hi from sigsafe_syscalls_.
+ */
+static void
+sort_jmps(void)
+{
+    size_t i;
+
+    for (i = 0; i < NUM_SYSCALLS; i++) {
+        struct sigsafe_jmp_ r;
+
+        r.minjmp = SIGSAFE_LABEL_ADDR(sigsafe_syscalls_[i].minjmp);
+        r.maxjmp = (char*) SIGSAFE_LABEL_ADDR(sigsafe_syscalls_[i].maxjmp)
+                 + SIGSAFE_MAXJMP_SLOP;
+        r.jmpto  = SIGSAFE_LABEL_ADDR(sigsafe_syscalls_[i].jmpto);
+        insert_jmp(jmps_by_addr, i, r);
+    }
+    if (NUM_SYSCALLS > 0) {
+        jmps_lo = jmps_by_addr[0].minjmp;
+        jmps_hi = jmps_by_addr[NUM_SYSCALLS - 1].maxjmp;
+    }
+}
+
+/** Publishes a filled-in table to the signal handler. */
+static void
+push_jmptab(struct jmptab *t)
+{
+    t->next = jmptabs;
+#ifdef SIGSAFE_ATOMICS
+    while (!__atomic_compare_exchange_n(&jmptabs, &t->next, t, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) ;
+#else
+    COMPILER_BARRIER();
+    jmptabs = t; /* only safe from one thread at a time */
+#endif
+}
+
+#ifdef SIGSAFE_HAVE_INTERRUPTIBLE
+/* Bounds of the library's own interruptible section. */
+extern char __start_sigsafe_interruptible[]
+        __attribute__ ((weak, visibility ("hidden")));
+extern char __stop_sigsafe_interruptible[]
+        __attribute__ ((weak, visibility ("hidden")));
+
+/** Where the handler sends a thread interrupted in an interruptible region. */
+INTERNAL_DEC void sigsafe_interruptible_jmpto_(void);
+
+/**
+ * Registers a module's interruptible section, unless already done.
+ * The library's own and, when linked statically, the program's are the
+ * same section.
+ */
+static int
+register_interruptible(void *start, void *stop)
+{
+    struct jmptab *t;
+
+    if (start == NULL || start == stop) {
+        return 0;
+    }
+    for (t = jmptabs; t != NULL; t = t->next) {
+        if (t->lo == start
+            && t->jmps[0].jmpto == (void*) sigsafe_interruptible_jmpto_) {
+            return 0;
+        }
+    }
+    return sigsafe_register_region(start, stop, sigsafe_interruptible_jmpto_);
+}
+#endif
+
+void
+sigsafe_register_jmptab_(void *start, void *stop)
+{
+    struct sigsafe_jmp_ *jmps = (struct sigsafe_jmp_*) start;
+    size_t n = (struct sigsafe_jmp_*) stop - jmps;
+    struct jmptab *t;
+    size_t i;
+
+    if (n == 0) {
+        return;
+    }
+
+    /* Every file using the inline wrappers registers its module's table. */
+    for (t = jmptabs; t != NULL; t = t->next) {
+        if (t->jmps == jmps) {
+            return;
+        }
+    }
+
+    t = (struct jmptab*) malloc(sizeof(struct jmptab));
+    if (t == NULL) {
+        /* Can't return an error from a constructor, and can't run safely. */
+        abort();
+    }
+
+    /* The section is writable; sort it in place before anyone can see it. */
+    for (i = 1; i < n; i++) {
+        insert_jmp(jmps, i, jmps[i]);
+    }
+    t->jmps = jmps;
+    t->n = n;
+    t->lo = jmps[0].minjmp;
+    t->hi = jmps[0].maxjmp;
+    for (i = 1; i < n; i++) {
+        if (t->hi < jmps[i].maxjmp) {
+            t->hi = jmps[i].maxjmp;
+        }
+    }
+    push_jmptab(t);
+}
+
+int
+sigsafe_register_region(const void *start, const void *end,
+                        const void *recovery)
+{
+    struct jmptab *t;
+
+    if (start == NULL || end <= start || recovery == NULL) {
+        return -EINVAL;
+    }
+    t = (struct jmptab*) malloc(sizeof(struct jmptab)
+                                + sizeof(struct sigsafe_jmp_));
+    if (t == NULL) {
+        return -ENOMEM;
+    }
+    t->jmps = (struct sigsafe_jmp_*) (t + 1);
+    t->jmps[0].minjmp = (void*) start;
+    t->jmps[0].maxjmp = (char*) end - 1;
+    t->jmps[0].jmpto = (void*) recovery;
+    t->n = 1;
+    t->lo = t->jmps[0].minjmp;
+    t->hi = t->jmps[0].maxjmp;
+    push_jmptab(t);
+    return 0;
+}
+
+/* Fails to compile if sigsafe.h doesn't reserve enough room. */
+typedef char tsd_storage_fits[sizeof(struct sigsafe_tsd_storage)
+                              >= sizeof(struct sigsafe_tsd_) ? 1 : -1];
+
+/*
+ * sigsafe_install_tsd's data comes from slabs of cache-line-aligned slots
+ * mapped straight from the kernel, so threads coming and going never touch
+ * the heap or share a line. A slot is claimed by swinging its "used" word
+ * from 0 to 1, the way register_thread claims registry entries, and freed
+ * by storing 0. Slabs are never unmapped.
+ */
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define TSD_SLAB_SLOTS 64
+
+#ifdef __GNUC__
+#define CACHE_ALIGNED __attribute__ ((aligned (64)))
+#else
+#define CACHE_ALIGNED
+#endif
+
+struct tsd_slot {
+    struct sigsafe_tsd_ tsd; /* first, so a tsd's address is its slot's */
+    volatile int used;
+} CACHE_ALIGNED;
+
+struct tsd_slab {
+    struct tsd_slot slots[TSD_SLAB_SLOTS];
+    struct tsd_slab *next;
+};
+
+static struct tsd_slab * volatile tsd_slabs;
+
+#ifdef SIGSAFE_ATOMICS
+#define TSD_SLAB_LOCK()
+#define TSD_SLAB_UNLOCK()
+#elif defined(_THREAD_SAFE)
+static pthread_mutex_t tsd_slab_lock = PTHREAD_MUTEX_INITIALIZER;
+#define TSD_SLAB_LOCK()   pthread_mutex_lock(&tsd_slab_lock)
+#define TSD_SLAB_UNLOCK() pthread_mutex_unlock(&tsd_slab_lock)
+#else
+#define TSD_SLAB_LOCK()
+#define TSD_SLAB_UNLOCK()
+#endif
+
+/** Claims a free slot; without the atomic builtins, under tsd_slab_lock. */
+static int
+claim_slot(struct tsd_slot *slot)
+{
+#ifdef SIGSAFE_ATOMICS
+    int expected = 0;
+
+    return slot->used == 0
+           && __atomic_compare_exchange_n(&slot->used, &expected, 1, 0,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+#else
+    if (slot->used) {
+        return 0;
+    }
+    slot->used = 1;
+    return 1;
+#endif
+}
+
+/** Maps a slab of free slots, or returns NULL. */
+static struct tsd_slab *
+new_tsd_slab(void)
+{
+    struct tsd_slab *slab;
+
+    slab = (struct tsd_slab*) mmap(NULL, sizeof(struct tsd_slab),
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (slab == (struct tsd_slab*) MAP_FAILED) ? NULL : slab;
+}
+
+/** Makes a new slab's slots available to alloc_tsd. */
+static void
+push_tsd_slab(struct tsd_slab *slab)
+{
+    slab->next = tsd_slabs;
+#ifdef SIGSAFE_ATOMICS
+    while (!__atomic_compare_exchange_n(&tsd_slabs, &slab->next, slab, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) ;
+#else
+    tsd_slabs = slab; /* under tsd_slab_lock, if threaded */
+#endif
+}
+
+/**
+ * Takes a slot from the slabs, mapping a new slab if all are in use.
+ * @param grow map a new slab if need be
+ * @return its (uninitialized) data, or NULL if out of memory or (without
+ *         grow) free slots.
+ */
+static struct sigsafe_tsd_ *
+alloc_tsd(int grow)
+{
+    struct tsd_slab *slab;
+    struct sigsafe_tsd_ *tsd = NULL;
+    int i;
+
+    TSD_SLAB_LOCK();
+    for (slab = tsd_slabs; slab != NULL; slab = slab->next) {
+        for (i = 0; i < TSD_SLAB_SLOTS; i++) {
+            if (claim_slot(&slab->slots[i])) {
+                tsd = &slab->slots[i].tsd;
+                goto out;
+            }
+        }
+    }
+    slab = grow ? new_tsd_slab() : NULL;
+    if (slab == NULL) {
+        goto out;
+    }
+    slab->slots[0].used = 1;
+    tsd = &slab->slots[0].tsd;
+    push_tsd_slab(slab);
+out:
+    TSD_SLAB_UNLOCK();
+    return tsd;
+}
+
+/** Returns alloc_tsd's slot to the slabs. */
+static void
+free_tsd(struct sigsafe_tsd_ *tsd)
+{
+    struct tsd_slot *slot = (struct tsd_slot*) tsd;
+
+#ifdef SIGSAFE_ATOMICS
+    __atomic_store_n(&slot->used, 0, __ATOMIC_RELEASE);
+#else
+    TSD_SLAB_LOCK();
+    slot->used = 0;
+    TSD_SLAB_UNLOCK();
+#endif
+}
+
+/**
+ * Tears down data the thread no longer points to: the deadline timer, the
+ * registry entry, and the user's data, then its storage unless the caller
+ * owns that.
+ */
+static void
+release_tsd(struct sigsafe_tsd_ *tsd)
+{
+#ifdef SIGSAFE_HAVE_DEADLINE
+    if (tsd->deadline_timer != -1) {
+        syscall(SYS_timer_delete, tsd->deadline_timer);
+    }
+#endif
+#ifdef SIGSAFE_HAVE_INTERRUPT
+    __atomic_store_n(&tsd->thread->deadline_ns, 0, __ATOMIC_RELAXED);
+    memset((void*) tsd->thread->owned, 0, sizeof(tsd->thread->owned));
+    __atomic_store_n(&tsd->thread->tid, 0, __ATOMIC_RELEASE);
+#endif
+    if (tsd->destructor != NULL) {
+        tsd->destructor(tsd->user_data);
+    }
+    free(tsd->queue);
+    if (!tsd->caller_storage) {
+        free_tsd(tsd);
+    }
+}
+
 #ifdef _THREAD_SAFE
 static void
 tsd_destructor(void* tsd_v)
 {
-    struct sigsafe_tsd_ *sigsafe_data_ = (struct sigsafe_tsd_*) tsd_v;
-    if (sigsafe_data_->destructor != NULL) {
-        sigsafe_data_->destructor(sigsafe_data_->user_data);
-    }
-    free(sigsafe_data_);
+#ifndef SIGSAFE_TSD_KEY
+    sigsafe_data_ = NULL;
+#endif
+    release_tsd((struct sigsafe_tsd_*) tsd_v);
 }
 #endif
 
@@ -95,6 +719,14 @@ sigsafe_init(void)
     pthread_key_create(&sigsafe_key_, &tsd_destructor);
 #endif
 
+    sort_jmps();
+#ifdef SIGSAFE_HAVE_INTERRUPTIBLE
+    if (register_interruptible(__start_sigsafe_interruptible,
+                               __stop_sigsafe_interruptible) != 0) {
+        abort(); /* can't run sigsafe_run_interruptible safely */
+    }
+#endif
+
     /*
      * XXX
      * bbraun and landorf on #opendarwin tell me that dyld commonly deadlocks
@@ -103,7 +735,7 @@ sigsafe_init(void)
      * Should test this and note it in the documentation, so the userhandler
      * does the same thing.
      */
-#ifdef _THREAD_SAFE
+#ifdef SIGSAFE_TSD_KEY
     fp = &pthread_getspecific;
 #endif
     fp = &sigsafe_handler_for_platform_;
@@ -131,6 +763,9 @@ sigsafe_install_handler(int signum, sigsafe_user_handler_t handler)
     assert(0 < signum && signum <= SIGSAFE_SIGMAX);
     sigsafe_ensure_init();
     user_handlers[signum - 1] = handler;
+    deferred_mask[(signum - 1) / SIGSAFE_PENDING_BITS] &=
+            ~(1UL << ((signum - 1) % SIGSAFE_PENDING_BITS));
+    deferred_handlers[signum - 1] = NULL;
 #ifdef SIGSAFE_NO_SIGINFO
     sa.sa_handler = (void (*)(int)) &sighandler;
     sa.sa_flags = SA_RESTART;
@@ -150,48 +785,789 @@ sigsafe_install_handler(int signum, sigsafe_user_handler_t handler)
     return 0;
 }
 
-int
-sigsafe_install_tsd(intptr_t user_data, void (*destructor)(intptr_t))
+/**
+ * Fills in tsd and makes it this thread's, replacing any TSD a wrapper
+ * installed lazily.
+ * @param lazy a wrapper is installing this; take only reserved memory
+ * @return 0, or a negative errno; tsd's storage is still the caller's then.
+ */
+static int
+install_tsd(struct sigsafe_tsd_ *tsd, int caller_storage, int lazy,
+            intptr_t user_data, void (*destructor)(intptr_t))
 {
+    struct sigsafe_tsd_ *old;
 #ifdef _THREAD_SAFE
-    struct sigsafe_tsd_ *sigsafe_data_ = NULL;
     int retval;
 
     sigsafe_ensure_init();
-    assert(pthread_getspecific(sigsafe_key_) == NULL);
+    old = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
 #else
-    assert(sigsafe_data_ == NULL);
+    old = sigsafe_data_;
 #endif
+#ifdef SIGSAFE_HAVE_LAZY_TSD
+    if (old != NULL && old->lazy) {
+        sigsafe_remove_tsd();
+        old = NULL;
+    }
+#endif
+    assert(old == NULL);
 
-    sigsafe_data_ = (struct sigsafe_tsd_*) malloc(sizeof(struct sigsafe_tsd_));
-    if (sigsafe_data_ == NULL) {
+    memset(tsd, 0, sizeof(*tsd));
+    tsd->user_data = user_data;
+    tsd->destructor = destructor;
+    tsd->caller_storage = caller_storage;
+#ifdef SIGSAFE_HAVE_LAZY_TSD
+    tsd->lazy = lazy;
+#endif
+#ifdef SIGSAFE_HAVE_DEADLINE
+    tsd->deadline_timer = -1;
+#endif
+#ifdef SIGSAFE_HAVE_INTERRUPT
+    tsd->thread = register_thread(!lazy);
+    if (tsd->thread == NULL) {
         return -ENOMEM;
     }
-
-    sigsafe_data_->signal_received = 0;
-    sigsafe_data_->user_data = user_data;
-    sigsafe_data_->destructor = destructor;
+#endif
 
 #ifdef _THREAD_SAFE
-    retval = pthread_setspecific(sigsafe_key_, sigsafe_data_);
+    retval = pthread_setspecific(sigsafe_key_, tsd);
     if (retval != 0) {
-        free(sigsafe_data_);
+#ifdef SIGSAFE_HAVE_INTERRUPT
+        __atomic_store_n(&tsd->thread->tid, 0, __ATOMIC_RELEASE);
+#endif
         return -retval;
     }
 #endif
+#ifndef SIGSAFE_TSD_KEY
+    /* Publish only once it is fully set up; the handler may look at once. */
+    sigsafe_data_ = tsd;
+#endif
 
     return 0;
 }
 
-intptr_t
-sigsafe_clear_received(void)
+int
+sigsafe_install_tsd(intptr_t user_data, void (*destructor)(intptr_t))
 {
-#ifdef _THREAD_SAFE
-    struct sigsafe_tsd_ *sigsafe_data_;
+    struct sigsafe_tsd_ *tsd;
+    int retval;
 
-    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
-#endif
-    assert(sigsafe_data_ != NULL);
-    sigsafe_data_->signal_received = 0;
-    return sigsafe_data_->user_data;
+    tsd = alloc_tsd(1);
+    if (tsd == NULL) {
+        return -ENOMEM;
+    }
+    retval = install_tsd(tsd, 0, 0, user_data, destructor);
+    if (retval != 0) {
+        free_tsd(tsd);
+    }
+    return retval;
+}
+
+int
+sigsafe_install_tsd_static(struct sigsafe_tsd_storage *storage,
+                           intptr_t user_data, void (*destructor)(intptr_t))
+{
+    return install_tsd((struct sigsafe_tsd_*) storage, 1, 0, user_data,
+                       destructor);
 }
+
+void
+sigsafe_remove_tsd(void)
+{
+    struct sigsafe_tsd_ *tsd;
+
+#ifdef _THREAD_SAFE
+    sigsafe_ensure_init();
+    tsd = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+    if (tsd == NULL) {
+        return;
+    }
+    pthread_setspecific(sigsafe_key_, NULL);
+#else
+    tsd = sigsafe_data_;
+    if (tsd == NULL) {
+        return;
+    }
+#endif
+#ifndef SIGSAFE_TSD_KEY
+    sigsafe_data_ = NULL;
+#endif
+    /* The handler must be done with it before it goes away. */
+    COMPILER_BARRIER();
+    release_tsd(tsd);
+}
+
+#ifdef SIGSAFE_HAVE_LAZY_TSD
+/** Non-zero once sigsafe_enable_lazy_tsd has been called. */
+static volatile int lazy_tsd;
+
+int
+sigsafe_enable_lazy_tsd(unsigned int reserve)
+{
+    struct tsd_slab *slab;
+    unsigned int free_slots = 0;
+    int i;
+#ifdef SIGSAFE_HAVE_INTERRUPT
+    struct sigsafe_thread_ *t;
+    unsigned int free_threads = 0;
+#endif
+
+    sigsafe_ensure_init();
+    TSD_SLAB_LOCK();
+    for (slab = tsd_slabs; slab != NULL; slab = slab->next) {
+        for (i = 0; i < TSD_SLAB_SLOTS; i++) {
+            free_slots += !slab->slots[i].used;
+        }
+    }
+    for (; free_slots < reserve; free_slots += TSD_SLAB_SLOTS) {
+        slab = new_tsd_slab();
+        if (slab == NULL) {
+            TSD_SLAB_UNLOCK();
+            return -ENOMEM;
+        }
+        push_tsd_slab(slab);
+    }
+    TSD_SLAB_UNLOCK();
+
+#ifdef SIGSAFE_HAVE_INTERRUPT
+    for (t = sigsafe_threads_; t != NULL; t = t->next) {
+        free_threads += (t->tid == 0);
+    }
+    for (; free_threads < reserve; free_threads++) {
+        t = new_thread(0);
+        if (t == NULL) {
+            return -ENOMEM;
+        }
+        push_thread(t);
+    }
+#endif
+
+    lazy_tsd = 1;
+    return 0;
+}
+
+void
+sigsafe_disable_lazy_tsd(void)
+{
+    lazy_tsd = 0;
+}
+
+/**
+ * Called by the wrappers (through sigsafe_lazy_tsd_stub_, which saves the
+ * argument registers) when the calling thread has no TSD. Takes only what
+ * sigsafe_enable_lazy_tsd reserved; once that is gone, the thread goes
+ * without, as if lazy install were off.
+ * @return the newly-installed TSD, or NULL if lazy install is off or failed.
+ */
+INTERNAL_DEF struct sigsafe_tsd_ *
+sigsafe_lazy_tsd_(void)
+{
+    struct sigsafe_tsd_ *tsd;
+    sigset_t all, old;
+
+    if (!lazy_tsd) {
+        return NULL;
+    }
+
+    /* A handler's sigsafe call mustn't install underneath us. */
+    sigfillset(&all);
+#ifdef _THREAD_SAFE
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+#else
+    sigprocmask(SIG_BLOCK, &all, &old);
+#endif
+    tsd = alloc_tsd(0);
+    if (tsd != NULL && install_tsd(tsd, 0, 1, 0, NULL) != 0) {
+        free_tsd(tsd);
+        tsd = NULL;
+    }
+#ifdef _THREAD_SAFE
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+#else
+    sigprocmask(SIG_SETMASK, &old, NULL);
+#endif
+    return tsd;
+}
+
+/* For sigsafe_inline.h, which can't reach the internal symbol. */
+const volatile sig_atomic_t *
+sigsafe_lazy_flag_(void)
+{
+    static const volatile sig_atomic_t never = 0;
+    struct sigsafe_tsd_ *tsd = sigsafe_lazy_tsd_();
+
+    return (tsd != NULL) ? &tsd->signal_received : &never;
+}
+#endif
+
+intptr_t
+sigsafe_clear_received(void)
+{
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+    sigsafe_data_->signal_received = 0;
+    return sigsafe_data_->user_data;
+}
+
+int
+sigsafe_signal_pending(void)
+{
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    return sigsafe_data_ != NULL && sigsafe_data_->signal_received != 0;
+}
+
+/*
+ * FETCH_AND_CLEAR reads and zeroes a word the signal handler may set. It
+ * only needs to be atomic with respect to a signal arriving in this thread,
+ * which a single exchange instruction is. Without the builtin, signals are
+ * blocked around the whole of sigsafe_fetch_received instead.
+ */
+#ifdef SIGSAFE_ATOMICS
+#define FETCH_AND_CLEAR(p) __atomic_exchange_n((p), 0, __ATOMIC_SEQ_CST)
+#define FETCH_AND_CLEAR_BITS(p, bits) \
+        __atomic_fetch_and((p), ~(bits), __ATOMIC_SEQ_CST)
+#else
+#define FETCH_AND_CLEAR(p) (fetched = *(p), *(p) = 0, fetched)
+#define FETCH_AND_CLEAR_BITS(p, bits) (fetched = *(p), *(p) &= ~(bits), fetched)
+#define FETCH_AND_CLEAR_BLOCKS
+#ifdef _THREAD_SAFE
+#define SIGMASK pthread_sigmask
+#else
+#define SIGMASK sigprocmask
+#endif
+#endif
+
+/**
+ * sigsafe_fetch_received, taking only the signals in <tt>which</tt> (all if
+ * NULL) and leaving the others pending.
+ */
+static intptr_t
+fetch_received(const sigset_t *which, sigset_t *received,
+               unsigned int *counts, int ncounts)
+{
+    unsigned long mask[SIGSAFE_PENDING_WORDS];
+    size_t w;
+    int i;
+#ifdef FETCH_AND_CLEAR_BLOCKS
+    unsigned long fetched;
+    sigset_t all, old;
+#endif
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+
+    if (received != NULL) {
+        sigemptyset(received);
+    }
+    for (i = 0; counts != NULL && i < ncounts; i++) {
+        counts[i] = 0;
+    }
+    for (w = 0; w < SIGSAFE_PENDING_WORDS; w++) {
+        mask[w] = (which == NULL) ? ~0UL : 0;
+    }
+    for (i = 1; which != NULL && i <= SIGSAFE_SIGMAX; i++) {
+        if (sigismember(which, i) == 1) {
+            mask[(i - 1) / SIGSAFE_PENDING_BITS] |=
+                    1UL << ((i - 1) % SIGSAFE_PENDING_BITS);
+        }
+    }
+#ifdef FETCH_AND_CLEAR_BLOCKS
+    sigfillset(&all);
+    SIGMASK(SIG_BLOCK, &all, &old);
+#endif
+
+    /*
+     * Clear the flag first. A signal arriving after this point is reported
+     * now or by the next call, but is never forgotten with the flag clear.
+     */
+    sigsafe_data_->signal_received = 0;
+    for (w = 0; w < SIGSAFE_PENDING_WORDS; w++) {
+        unsigned long bits;
+
+        if (mask[w] == ~0UL) {
+            bits = FETCH_AND_CLEAR(&sigsafe_data_->pending[w]);
+        } else if ((sigsafe_data_->pending[w] & mask[w]) != 0) {
+            bits = FETCH_AND_CLEAR_BITS(&sigsafe_data_->pending[w], mask[w])
+                   & mask[w];
+        } else {
+            continue;
+        }
+        for (i = 0; bits != 0; i++, bits >>= 1) {
+            int signum = w * SIGSAFE_PENDING_BITS + i + 1;
+            unsigned int n;
+
+            if (!(bits & 1)) {
+                continue;
+            }
+            n = FETCH_AND_CLEAR(&sigsafe_data_->counts[signum - 1]);
+            if (n == 0) {
+                /*
+                 * The handler counts before it sets the bit, so this is a
+                 * bit set again after a signal the last call already took.
+                 */
+                continue;
+            }
+            if (received != NULL) {
+                sigaddset(received, signum);
+            }
+            if (counts != NULL && signum < ncounts) {
+                counts[signum] = n;
+            }
+        }
+    }
+
+#ifdef FETCH_AND_CLEAR_BLOCKS
+    SIGMASK(SIG_SETMASK, &old, NULL);
+#endif
+    return sigsafe_data_->user_data;
+}
+
+intptr_t
+sigsafe_fetch_received(sigset_t *received, unsigned int *counts, int ncounts)
+{
+    return fetch_received(NULL, received, counts, ncounts);
+}
+
+intptr_t
+sigsafe_fetch_received_in(const sigset_t *which, sigset_t *received,
+                          unsigned int *counts, int ncounts)
+{
+    return fetch_received(which, received, counts, ncounts);
+}
+
+int
+sigsafe_install_deferred_handler(int signum,
+                                 sigsafe_deferred_handler_t handler)
+{
+    int retval;
+
+    assert(handler != NULL);
+    retval = sigsafe_install_handler(signum, NULL);
+    if (retval != 0) {
+        return retval;
+    }
+    deferred_handlers[signum - 1] = handler;
+    deferred_mask[(signum - 1) / SIGSAFE_PENDING_BITS] |=
+            1UL << ((signum - 1) % SIGSAFE_PENDING_BITS);
+    return 0;
+}
+
+int
+sigsafe_dispatch_pending(void)
+{
+    unsigned long bits[SIGSAFE_PENDING_WORDS];
+    unsigned int counts[SIGSAFE_SIGMAX];
+    size_t w;
+    int i, n = 0;
+#ifdef FETCH_AND_CLEAR_BLOCKS
+    unsigned long fetched;
+    sigset_t all, old;
+#endif
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+
+    /*
+     * Take the deferred signals' bits and counts all at once, leaving the
+     * others for sigsafe_fetch_received. Then run the handlers, which may
+     * take as long as they like and be interrupted by more signals.
+     */
+#ifdef FETCH_AND_CLEAR_BLOCKS
+    sigfillset(&all);
+    SIGMASK(SIG_BLOCK, &all, &old);
+#endif
+    for (w = 0; w < SIGSAFE_PENDING_WORDS; w++) {
+        unsigned long mask = deferred_mask[w];
+        bits[w] = 0;
+        if ((sigsafe_data_->pending[w] & mask) == 0) {
+            continue;
+        }
+        bits[w] = FETCH_AND_CLEAR_BITS(&sigsafe_data_->pending[w], mask)
+                  & mask;
+        for (i = 0; i < SIGSAFE_PENDING_BITS; i++) {
+            if (bits[w] & (1UL << i)) {
+                int signum = w * SIGSAFE_PENDING_BITS + i + 1;
+                counts[signum - 1] =
+                        FETCH_AND_CLEAR(&sigsafe_data_->counts[signum - 1]);
+                if (counts[signum - 1] == 0) {
+                    /* Already dispatched; see sigsafe_fetch_received. */
+                    bits[w] &= ~(1UL << i);
+                }
+            }
+        }
+    }
+#ifdef FETCH_AND_CLEAR_BLOCKS
+    SIGMASK(SIG_SETMASK, &old, NULL);
+#endif
+
+    for (w = 0; w < SIGSAFE_PENDING_WORDS; w++) {
+        for (i = 0; bits[w] != 0; i++, bits[w] >>= 1) {
+            int signum = w * SIGSAFE_PENDING_BITS + i + 1;
+            sigsafe_deferred_handler_t handler;
+
+            if (!(bits[w] & 1)) {
+                continue;
+            }
+            handler = deferred_handlers[signum - 1];
+            if (handler != NULL) {
+                handler(signum, counts[signum - 1], sigsafe_data_->user_data);
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+int
+sigsafe_install_siginfo_queue(unsigned int entries)
+{
+    struct sigsafe_siginfo_queue_ *q, *old;
+    unsigned int size;
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+
+    if (entries > SIGSAFE_SIGINFO_QUEUE_MAX) {
+        return -EINVAL;
+    }
+    q = NULL;
+    if (entries > 0) {
+        for (size = 1; size < entries; size <<= 1) ;
+        q = (struct sigsafe_siginfo_queue_*)
+            malloc(sizeof(*q) + (size - 1) * sizeof(q->entries[0]));
+        if (q == NULL) {
+            return -ENOMEM;
+        }
+        q->mask = size - 1;
+        q->head = q->tail = 0;
+        q->dropped = 0;
+    }
+
+    /* The handler runs in this thread, so it sees one ring or the other. */
+    old = sigsafe_data_->queue;
+    sigsafe_data_->queue = q;
+    free(old);
+    return 0;
+}
+
+int
+sigsafe_drain_siginfo(struct sigsafe_siginfo *buf, int max,
+                      unsigned long *dropped)
+{
+    struct sigsafe_siginfo_queue_ *q;
+    unsigned int head, tail;
+    int n = 0;
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+
+    q = sigsafe_data_->queue;
+    if (q == NULL) {
+        if (dropped != NULL) {
+            *dropped = 0;
+        }
+        return 0;
+    }
+    head = q->head;
+    tail = q->tail;
+    for (; head != tail && n < max; head++, n++) {
+        buf[n] = q->entries[head & q->mask];
+    }
+
+    /* Only give the slots back to the handler once they are copied. */
+    COMPILER_BARRIER();
+    q->head = head;
+    if (dropped != NULL) {
+#ifdef FETCH_AND_CLEAR_BLOCKS
+        unsigned long fetched;
+        sigset_t all, old;
+
+        sigfillset(&all);
+        SIGMASK(SIG_BLOCK, &all, &old);
+        *dropped = FETCH_AND_CLEAR(&q->dropped);
+        SIGMASK(SIG_SETMASK, &old, NULL);
+#else
+        *dropped = FETCH_AND_CLEAR(&q->dropped);
+#endif
+    }
+    return n;
+}
+
+#ifdef SIGSAFE_HAVE_DEADLINE
+int
+sigsafe_install_deadline_handler(int signum)
+{
+    int retval;
+
+    retval = sigsafe_install_handler(signum, NULL);
+    if (retval == 0) {
+        deadline_signum = signum;
+    }
+    return retval;
+}
+
+int
+sigsafe_set_deadline(const struct timespec *deadline)
+{
+    struct itimerspec its;
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+    if (deadline_signum == 0) {
+        return -EINVAL;
+    }
+    if (deadline != NULL && (deadline->tv_sec < 0 || deadline->tv_nsec < 0
+                             || deadline->tv_nsec >= 1000000000)) {
+        return -EINVAL;
+    }
+
+    if (sigsafe_data_->deadline_timer == -1) {
+        struct sigevent sev;
+        int timer;
+
+        if (deadline == NULL) {
+            return 0;
+        }
+        memset(&sev, 0, sizeof(sev));
+        sev.sigev_notify = SIGEV_THREAD_ID;
+        sev.sigev_signo = deadline_signum;
+        sev.sigev_value.sival_ptr = sigsafe_data_;
+        sev.sigev_notify_thread_id = syscall(SYS_gettid);
+        if (syscall(SYS_timer_create, CLOCK_MONOTONIC, &sev, &timer) != 0) {
+            return -errno;
+        }
+        sigsafe_data_->deadline_timer = timer;
+    }
+
+    memset(&its, 0, sizeof(its));
+    if (deadline != NULL) {
+        its.it_value = *deadline;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+            its.it_value.tv_nsec = 1; /* zero would disarm the timer */
+        }
+    }
+    __atomic_store_n(&sigsafe_data_->deadline_ns,
+                     (deadline != NULL) ? timespec_ns(&its.it_value) : 0,
+                     __ATOMIC_RELAXED);
+    sigsafe_data_->deadline_expired = 0;
+    if (syscall(SYS_timer_settime, sigsafe_data_->deadline_timer,
+                TIMER_ABSTIME, &its, NULL) != 0) {
+        __atomic_store_n(&sigsafe_data_->deadline_ns, 0, __ATOMIC_RELAXED);
+        return -errno;
+    }
+    return 0;
+}
+
+int
+sigsafe_deadline_expired(void)
+{
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+    return sigsafe_data_->deadline_expired;
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_INTERRUPT
+int
+sigsafe_install_interrupt_handler(int signum)
+{
+    int retval;
+
+    retval = sigsafe_install_handler(signum, NULL);
+    if (retval == 0) {
+        sigsafe_interrupt_signum_ = signum;
+    }
+    return retval;
+}
+
+sigsafe_thread_t
+sigsafe_thread_self(void)
+{
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+    return sigsafe_data_->thread;
+}
+
+int
+sigsafe_interrupt_thread(sigsafe_thread_t thread)
+{
+    pid_t tid = __atomic_load_n(&thread->tid, __ATOMIC_ACQUIRE);
+
+    if (sigsafe_interrupt_signum_ == 0) {
+        return -EINVAL;
+    }
+    if (tid == 0) {
+        return -ESRCH;
+    }
+    if (syscall(SYS_tgkill, getpid(), tid, sigsafe_interrupt_signum_) != 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+int
+sigsafe_interrupt_all(void)
+{
+    struct sigsafe_thread_ *t;
+    pid_t pid = getpid();
+    int n = 0;
+
+    if (sigsafe_interrupt_signum_ == 0) {
+        return -EINVAL;
+    }
+    for (t = __atomic_load_n(&sigsafe_threads_, __ATOMIC_ACQUIRE); t != NULL;
+         t = t->next) {
+        pid_t tid = __atomic_load_n(&t->tid, __ATOMIC_ACQUIRE);
+        if (tid != 0 && syscall(SYS_tgkill, pid, tid, sigsafe_interrupt_signum_) == 0) {
+            n++;
+        }
+    }
+    return n;
+}
+
+int
+sigsafe_route_signal(int signum, int mode)
+{
+    int word;
+    unsigned long bit;
+
+    if (signum <= 0 || signum > SIGSAFE_SIGMAX) {
+        return -EINVAL;
+    }
+    word = SIGBIT_WORD(signum);
+    bit = SIGBIT(signum);
+    switch (mode) {
+    case SIGSAFE_ROUTE_NONE:
+        __atomic_fetch_and(&routed_mask[word], ~bit, __ATOMIC_RELEASE);
+        break;
+    case SIGSAFE_ROUTE_ONE:
+        __atomic_fetch_and(&routed_all_mask[word], ~bit, __ATOMIC_RELEASE);
+        __atomic_fetch_or(&routed_mask[word], bit, __ATOMIC_RELEASE);
+        break;
+    case SIGSAFE_ROUTE_ALL:
+        __atomic_fetch_or(&routed_all_mask[word], bit, __ATOMIC_RELEASE);
+        __atomic_fetch_or(&routed_mask[word], bit, __ATOMIC_RELEASE);
+        break;
+    default:
+        return -EINVAL;
+    }
+    return 0;
+}
+
+int
+sigsafe_own_signal(int signum, int own)
+{
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+    if (signum <= 0 || signum > SIGSAFE_SIGMAX) {
+        return -EINVAL;
+    }
+    if (own) {
+        __atomic_fetch_or(&sigsafe_data_->thread->owned[SIGBIT_WORD(signum)],
+                          SIGBIT(signum), __ATOMIC_RELEASE);
+    } else {
+        __atomic_fetch_and(&sigsafe_data_->thread->owned[SIGBIT_WORD(signum)],
+                           ~SIGBIT(signum), __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_INTERRUPTIBLE
+/**
+ * Calls fn once the signal received flag is clear. This lives in the
+ * library's interruptible section, so a signal from the check onward
+ * unwinds to sigsafe_run_interruptible_ rather than slipping in between the
+ * check and the call.
+ */
+static int SIGSAFE_INTERRUPTIBLE
+call_interruptible(const volatile sig_atomic_t *flag, void (*fn)(void*),
+                   void *arg)
+{
+    if (*flag) {
+        return -EINTR;
+    }
+    fn(arg);
+    return 0;
+}
+
+/** Called by sigsafe_interruptible_jmpto_ with a freshly aligned stack. */
+INTERNAL_DEF void
+sigsafe_interruptible_recover_(void)
+{
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    if (sigsafe_data_ == NULL || sigsafe_data_->interrupt_env == NULL) {
+        /* An interruptible function was called directly; can't recover. */
+        abort();
+    }
+    longjmp(*sigsafe_data_->interrupt_env, 1);
+}
+
+int
+sigsafe_run_interruptible_(void (*fn)(void*), void *arg, void *start,
+                           void *stop)
+{
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+#endif
+    jmp_buf env, *saved;
+    int retval;
+
+#ifdef SIGSAFE_TSD_KEY
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+    retval = register_interruptible(start, stop);
+    if (retval != 0) {
+        return retval;
+    }
+    saved = sigsafe_data_->interrupt_env;
+    if (setjmp(env) == 0) {
+        sigsafe_data_->interrupt_env = &env;
+        retval = call_interruptible(&sigsafe_data_->signal_received, fn, arg);
+    } else {
+        retval = -EINTR;
+    }
+    sigsafe_data_->interrupt_env = saved;
+    return retval;
+}
+#endif
@@ -124,6 +124,57 @@ typedef void (*sigsafe_user_handler_t)(int, siginfo_t*, ucontext_t*, intptr_t);
  */
 int sigsafe_install_handler(int signum, sigsafe_user_handler_t handler);
 
+/**
+ * @typedef sigsafe_deferred_handler_t
+ * A deferred signal handler, run by sigsafe_dispatch_pending() in normal
+ * thread context. Unlike a sigsafe_user_handler_t, it may call anything.
+ * Arguments:
+ * - <tt>int signo</tt>: The signal number received.
+ * - <tt>unsigned int count</tt>: How many times it was received since the
+ *   handler last ran in this thread.
+ * - <tt>intptr_t user_data</tt>: The data you passed to sigsafe_install_tsd()
+ *   in this thread.
+ */
+typedef void (*sigsafe_deferred_handler_t)(int, unsigned int, intptr_t);
+
+/**
+ * Installs a safe signal handler whose user code runs later, outside signal
+ * context. The signal handler itself only records the signal, so all
+ * signals are masked for as short a time as possible, and the deferred
+ * handler may log, reload configuration, or anything else.
+ * Replaces any handler previously installed for <tt>signum</tt>;
+ * sigsafe_install_handler() likewise replaces this one.
+ * @param signum  The signal number
+ * @param handler The handler, to be run by sigsafe_dispatch_pending().
+ * @return as sigsafe_install_handler().
+ */
+int sigsafe_install_deferred_handler(int signum,
+                                     sigsafe_deferred_handler_t handler);
+
+/**
+ * Runs, in this thread, the deferred handler of each signal received by this
+ * thread since its handler last ran. Call it when a sigsafe system call
+ * returns <tt>-EINTR</tt>, or whenever convenient.
+ * @par Usage example:
+ * @code
+ * while ((retval = sigsafe_read(fd, buf, count)) == -EINTR) {
+ *     sigsafe_clear_received();
+ *     sigsafe_dispatch_pending();
+ * }
+ * @endcode
+ * Signals with deferred handlers are then no longer reported by
+ * sigsafe_fetch_received(); others are left for it. This does not clear the
+ * signal received flag.
+ * @return the number of handlers run.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ */
+int sigsafe_dispatch_pending(void);
+
+#if defined(SIGSAFE_HAVE_INTERRUPT) || defined(DOXYGEN)
+/** A thread with sigsafe TSD, for sigsafe_interrupt_thread(). */
+typedef struct sigsafe_thread_ *sigsafe_thread_t;
+#endif
+
 /**
  * Installs thread-specific data.
  * Before this is called for a given thread, "safe" signals delivered to that
@@ -142,6 +193,76 @@ int sigsafe_install_handler(int signum, sigsafe_user_handler_t handler);
  */
 int sigsafe_install_tsd(intptr_t userdata, void (*destructor)(intptr_t));
 
+/** Bytes reserved in a struct sigsafe_tsd_storage. */
+#define SIGSAFE_TSD_STORAGE_SIZE 1024
+
+/**
+ * Room for one thread's sigsafe data, for sigsafe_install_tsd_static().
+ * The contents are private.
+ */
+struct sigsafe_tsd_storage {
+    union {
+        char bytes[SIGSAFE_TSD_STORAGE_SIZE];
+        long long align_ll;
+        void *align_p;
+        double align_d;
+    } opaque_;
+};
+
+/**
+ * Installs thread-specific data in caller-owned storage.
+ * Like sigsafe_install_tsd(), but sigsafe keeps its per-thread data in
+ * <tt>storage</tt> instead of allocating it, for example in the thread's
+ * outermost stack frame or a per-worker arena.
+ * @pre This function has not previously been called in this thread.
+ * @pre <tt>storage</tt> stays valid until sigsafe_remove_tsd() is called in
+ *      this thread or the thread exits. Storage on the thread's own stack
+ *      must be removed before that frame returns.
+ * @param storage    Space for the data; needn't be initialized.
+ * @param userdata   As for sigsafe_install_tsd().
+ * @param destructor As for sigsafe_install_tsd().
+ */
+int sigsafe_install_tsd_static(struct sigsafe_tsd_storage *storage,
+                               intptr_t userdata,
+                               void (*destructor)(intptr_t));
+
+/**
+ * Removes this thread's thread-specific data now rather than at thread exit.
+ * Runs the destructor given when it was installed, if any, even in
+ * single-threaded compiles. Afterward signals are ignored in this thread as
+ * before sigsafe_install_tsd(), and either install function may be called
+ * again. Does nothing if there is no data installed.
+ */
+void sigsafe_remove_tsd(void);
+
+#if defined(SIGSAFE_HAVE_LAZY_TSD) || defined(DOXYGEN)
+/**
+ * Installs thread-specific data automatically on each thread's first sigsafe
+ * system call, so threads started by code you don't control get
+ * <tt>-EINTR</tt> too. Such threads get user data 0 and no destructor.
+ * The install blocks signals briefly and draws from a pool, which this
+ * call fills ahead of time, so a wrapper never allocates memory.
+ * Threads that call sigsafe_install_tsd() or sigsafe_install_tsd_static()
+ * themselves are unaffected; if one made a sigsafe call first, its own
+ * install replaces the TSD that call got.
+ * @note Signals a thread receives before its first sigsafe call are still
+ * ignored, as without this. So are a thread's signals if the pool had run
+ * out at that call; exited threads' TSD returns to the pool, and calling
+ * this again adds more.
+ * @param reserve Threads to have room for before more must be mapped.
+ * @return 0 on success, or <tt>-ENOMEM</tt>.
+ * @note Available on Linux/x86 and Linux/x86_64.
+ */
+int sigsafe_enable_lazy_tsd(unsigned int reserve);
+
+/**
+ * Turns off what sigsafe_enable_lazy_tsd() turned on. Threads that already
+ * got TSD lazily keep it; the reserved pool stays for later use.
+ * @note Available on Linux/x86 and Linux/x86_64.
+ */
+void sigsafe_disable_lazy_tsd(void);
+#endif
+
 /**
  * Clears the signal received flag for this thread.
  * After calling this function, sigsafe system calls will not receive
@@ -163,6 +284,390 @@ int sigsafe_install_tsd(intptr_t userdata, void (*destructor)(intptr_t));
  */
 intptr_t sigsafe_clear_received(void);
 
+/**
+ * Returns non-zero iff a safe signal has arrived in this thread since the
+ * flag was last cleared, without clearing it. Cheap enough to call every
+ * few iterations of a compute loop; sigsafe_signal_pending_inline() from
+ * sigsafe_inline.h is cheaper still.
+ * @return 0 in threads without TSD.
+ */
+int sigsafe_signal_pending(void);
+
+/**
+ * Clears the signal received flag for this thread and reports exactly which
+ * signals arrived, and how many times each, since the last call. One call
+ * tells an interrupted thread why, without a side channel of its own.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ * @param received  If non-NULL, set to the signals received.
+ * @param counts    If non-NULL, <tt>counts[signum]</tt> is set to the number
+ *                  of times <tt>signum</tt> was received, for each
+ *                  <tt>signum</tt> less than <tt>ncounts</tt>. An array of
+ *                  <tt>NSIG</tt> covers every signal.
+ * @param ncounts   Length of <tt>counts</tt>.
+ * @returns The user-specified data given when the TSD was installed for this
+ *          thread.
+ * @note A signal arriving during this call may be reported now or by the
+ * next call; in the latter case, the flag may still be set now.
+ */
+intptr_t sigsafe_fetch_received(sigset_t *received, unsigned int *counts,
+                                int ncounts);
+
+/**
+ * Like sigsafe_fetch_received(), but takes only the signals in
+ * <tt>which</tt>, leaving any others for a later sigsafe_fetch_received()
+ * or sigsafe_dispatch_pending(). It still clears the flag, so code that
+ * handles some signals itself, such as the @ref sigsafe_reactor "reactor",
+ * can go back to waiting without losing the rest.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ */
+intptr_t sigsafe_fetch_received_in(const sigset_t *which, sigset_t *received,
+                                   unsigned int *counts, int ncounts);
+
+/** Information about one signal, as saved by sigsafe_install_siginfo_queue. */
+struct sigsafe_siginfo {
+    int signo;                  /**< the signal number */
+    int code;                   /**< <tt>si_code</tt> */
+    union sigval value;         /**< <tt>si_value</tt>, as from sigqueue */
+    pid_t pid;                  /**< <tt>si_pid</tt> */
+};
+
+/** The most entries sigsafe_install_siginfo_queue() will allocate. */
+#define SIGSAFE_SIGINFO_QUEUE_MAX 65536
+
+/**
+ * Saves the information about each safe signal this thread receives in a
+ * fixed-size ring, to be collected with sigsafe_drain_siginfo(). This passes
+ * <tt>sigqueue()</tt> payloads to a thread with no system calls and no
+ * allocation in the handler. When the ring is full, further signals still
+ * set the flag as usual, but their information is counted and discarded.
+ * @param entries  The ring size, rounded up to a power of two, or 0 to stop
+ *                 saving. Any previous ring and its contents are discarded.
+ * @return 0 on success; <tt>-EINVAL</tt> if <tt>entries</tt> is more than
+ *         <tt>SIGSAFE_SIGINFO_QUEUE_MAX</tt>; <tt>-ENOMEM</tt>.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ * @par Portability:
+ * On NetBSD, only <tt>signo</tt> and <tt>code</tt> are filled in.
+ */
+int sigsafe_install_siginfo_queue(unsigned int entries);
+
+/**
+ * Removes up to <tt>max</tt> saved signals from this thread's ring, oldest
+ * first. Call it after a sigsafe call returns <tt>-EINTR</tt>, along with
+ * sigsafe_clear_received().
+ * @param dropped  If non-NULL, set to the number of signals discarded
+ *                 because the ring was full since the last call.
+ * @return the number of entries copied to <tt>buf</tt>.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ */
+int sigsafe_drain_siginfo(struct sigsafe_siginfo *buf, int max,
+                          unsigned long *dropped);
+
+#if defined(SIGSAFE_HAVE_INTERRUPT) || defined(DOXYGEN)
+/**
+ * Chooses the signal sigsafe_interrupt_thread() and sigsafe_interrupt_all()
+ * send and installs a safe handler for it. Use a signal reserved for this,
+ * such as <tt>SIGRTMIN + 1</tt>; this replaces any user handler for it.
+ * @par Availability:
+ * Linux.
+ */
+int sigsafe_install_interrupt_handler(int signum);
+
+/**
+ * Returns a handle for the calling thread. It is valid until the thread
+ * exits; then the handle may be reused for a later thread.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ */
+sigsafe_thread_t sigsafe_thread_self(void);
+
+/**
+ * Sends the interrupt signal to <tt>thread</tt>, so its blocked or next
+ * sigsafe call returns <tt>-EINTR</tt>.
+ * @return 0 on success; <tt>-EINVAL</tt> if no interrupt handler is
+ *         installed; <tt>-ESRCH</tt> if the thread has exited.
+ */
+int sigsafe_interrupt_thread(sigsafe_thread_t thread);
+
+/**
+ * Sends the interrupt signal to every thread that has called
+ * sigsafe_install_tsd() and not exited, including the caller. sigsafe keeps
+ * the list itself, so a graceful shutdown needs no list of its own.
+ * @return the number of threads signalled; <tt>-EINVAL</tt> if no interrupt
+ *         handler is installed.
+ */
+int sigsafe_interrupt_all(void);
+
+/** @name Modes for sigsafe_route_signal() */
+/*@{*/
+#define SIGSAFE_ROUTE_NONE 0 /**< deliver wherever the kernel chooses */
+#define SIGSAFE_ROUTE_ONE  1 /**< forward to one owning thread */
+#define SIGSAFE_ROUTE_ALL  2 /**< forward to every owning thread */
+/*@}*/
+
+/**
+ * Routes a process-directed signal to the threads which claim it with
+ * sigsafe_own_signal(). The kernel delivers such signals (<tt>kill</tt>,
+ * <tt>SIGCHLD</tt>, terminal signals) to any thread not blocking them, often
+ * one with no TSD where sigsafe would ignore it. With routing, the handler
+ * on any other thread forwards the signal to the owner(s) instead of
+ * handling it. <tt>sigqueue()</tt> signals keep their <tt>siginfo_t</tt>;
+ * the kernel won't let others be forwarded intact, so the owner sees them
+ * as sent by <tt>tgkill</tt> from this process. Signals sent
+ * to a thread in particular, such as by <tt>pthread_kill</tt>, are never
+ * forwarded. If no thread owns the signal, it is handled where it lands.
+ * @param mode SIGSAFE_ROUTE_NONE, SIGSAFE_ROUTE_ONE, or SIGSAFE_ROUTE_ALL.
+ * @pre sigsafe_install_handler() has been called for <tt>signum</tt>.
+ */
+int sigsafe_route_signal(int signum, int mode);
+
+/**
+ * Makes the calling thread an owner of <tt>signum</tt> (if <tt>own</tt> is
+ * non-zero) or stops it being one. Ownership ends when the thread exits.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ */
+int sigsafe_own_signal(int signum, int own);
+
+/**
+ * @defgroup sigsafe_pool Cancellable thread pool
+ * A work-stealing pool whose tasks may block in sigsafe calls and be
+ * cancelled by interrupting just the worker running them: the blocked call
+ * returns <tt>-EINTR</tt> and the task should return. Each worker has a
+ * deque; tasks submitted from a worker go on its own, and idle workers steal
+ * from the others. Tasks submitted from other threads share one queue. The
+ * signal received flag is cleared before each task, so a task never sees a
+ * signal meant for an earlier one.
+ * @par Usage example:
+ * @code
+ * static void fetch(void *arg) {
+ *     struct request *req = arg;
+ *     if (sigsafe_read(req->fd, req->buf, req->len) == -EINTR
+ *         && sigsafe_pool_cancelled()) {
+ *         return;
+ *     }
+ *     ...
+ * }
+ *
+ * sigsafe_pool_submit(pool, &req->task, fetch, req);
+ * ...
+ * sigsafe_pool_cancel(&req->task);
+ * sigsafe_pool_wait(&req->task);   // fetch has returned or never will
+ * @endcode
+ * @par Availability:
+ * Linux, in multithreaded builds.
+ */
+/*@{*/
+
+/** A task body, called with the argument given to sigsafe_pool_submit(). */
+typedef void (*sigsafe_pool_fn_t)(void*);
+
+/**
+ * A submitted task, in storage you must keep until sigsafe_pool_wait()
+ * returns for it. Treat the members as private.
+ */
+struct sigsafe_task {
+    sigsafe_pool_fn_t fn;
+    void *arg;
+    volatile int state;         /**< and whether anyone waits on it */
+    sigsafe_thread_t worker;    /**< the worker running it */
+    struct sigsafe_task *next;  /**< in the shared queue */
+};
+
+struct sigsafe_pool;
+
+/**
+ * Starts a pool of <tt>workers</tt> threads, each with sigsafe TSD.
+ * @return 0 on success; <tt>-EINVAL</tt> for a bad count or if
+ *         sigsafe_install_interrupt_handler() hasn't been called;
+ *         <tt>-ENOSYS</tt> in single-threaded builds; <tt>-Exxx</tt>
+ *         if a thread couldn't be started or couldn't get its TSD.
+ */
+int sigsafe_pool_create(struct sigsafe_pool **pool, int workers);
+
+/** Runs the tasks still queued, then stops the workers and frees the pool. */
+void sigsafe_pool_destroy(struct sigsafe_pool *pool);
+
+/**
+ * Queues <tt>fn(arg)</tt> to run on some worker.
+ * @return 0 on success; <tt>-ENOSYS</tt> in single-threaded builds.
+ */
+int sigsafe_pool_submit(struct sigsafe_pool *pool, struct sigsafe_task *task,
+                        sigsafe_pool_fn_t fn, void *arg);
+
+/**
+ * Cancels a task. One still queued will not run. One running has its
+ * worker interrupted, which affects no other task.
+ * @return 0 if cancelled; <tt>-ESRCH</tt> if it already finished or was
+ *         already cancelled; otherwise the error from
+ *         sigsafe_interrupt_thread(), and the task runs on.
+ */
+int sigsafe_pool_cancel(struct sigsafe_task *task);
+
+/**
+ * Waits until a task has finished or, if it was cancelled before it
+ * started, until the pool has dropped it. Either way its storage is then
+ * yours again.
+ * @return 0 if it ran to completion; <tt>-ECANCELED</tt> if it was
+ *         cancelled before or while running.
+ */
+int sigsafe_pool_wait(struct sigsafe_task *task);
+
+/**
+ * From inside a task, tells whether sigsafe_pool_cancel() has been called
+ * for it. Use it to tell a cancellation's <tt>-EINTR</tt> from another
+ * signal's.
+ */
+int sigsafe_pool_cancelled(void);
+
+/*@}*/
+
+/**
+ * Starts a watchdog thread which interrupts threads that overrun the
+ * timeouts they set with sigsafe_watchdog_arm(). It wakes once per
+ * <tt>tick</tt> and signals only overdue threads, with
+ * sigsafe_interrupt_thread(), so timeouts are late by at most one tick.
+ * Arming and disarming are just stores; there is no timer per thread.
+ * @return 0 on success; <tt>-EBUSY</tt> if already started;
+ *         <tt>-EINVAL</tt> for a bad tick or if no interrupt handler is
+ *         installed; <tt>-ENOSYS</tt> in single-threaded builds.
+ * @pre sigsafe_install_interrupt_handler() has been called.
+ */
+int sigsafe_watchdog_start(const struct timespec *tick);
+
+/** Stops the watchdog thread, if running, and waits for it to exit. */
+void sigsafe_watchdog_stop(void);
+
+/**
+ * Asks the watchdog to interrupt the calling thread if it has not called
+ * sigsafe_watchdog_disarm() within <tt>timeout</tt>. A later call replaces
+ * the earlier timeout.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ */
+void sigsafe_watchdog_arm(const struct timespec *timeout);
+
+/**
+ * Cancels the calling thread's watchdog timeout.
+ * @return 1 if the watchdog fired (or is about to deliver its signal), so
+ *         an <tt>-EINTR</tt> was the timeout; 0 otherwise, including on a
+ *         second call.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ */
+int sigsafe_watchdog_disarm(void);
+#endif
+
+/**
+ * Registers a code region with the signal handler, just like the jump
+ * regions of the system call wrappers. When a safe signal arrives in a
+ * thread with TSD whose instruction pointer is in <tt>[start, end)</tt>,
+ * the handler resumes it at <tt>recovery</tt> instead. Registrations are
+ * permanent.
+ * @warning This is for hand-written assembly: <tt>recovery</tt> must be
+ * correct from every instruction of the region, with whatever is in the
+ * registers and on the stack there. C code should use
+ * sigsafe_run_interruptible().
+ * @return 0 on success; <tt>-EINVAL</tt> for an empty region;
+ *         <tt>-ENOMEM</tt>.
+ */
+int sigsafe_register_region(const void *start, const void *end,
+                            const void *recovery);
+
+#if defined(SIGSAFE_HAVE_INTERRUPTIBLE) || defined(DOXYGEN)
+/**
+ * Marks a function as interruptible, for sigsafe_run_interruptible().
+ * The compiler places it in the module's <tt>sigsafe_interruptible</tt>
+ * section, which is registered as a single region.
+ */
+#define SIGSAFE_INTERRUPTIBLE \
+        __attribute__ ((section ("sigsafe_interruptible"), noinline))
+
+/** @internal */
+extern char __start_sigsafe_interruptible[]
+        __attribute__ ((weak, visibility ("hidden")));
+/** @internal */
+extern char __stop_sigsafe_interruptible[]
+        __attribute__ ((weak, visibility ("hidden")));
+
+/** @internal The implementation of sigsafe_run_interruptible(). */
+int sigsafe_run_interruptible_(void (*fn)(void*), void *arg, void *start,
+                               void *stop);
+
+/**
+ * Runs <tt>fn(arg)</tt>, abandoning it if a safe signal arrives, so a
+ * CPU-bound loop can be cancelled without checking a flag as it goes.
+ * Costs a <tt>setjmp</tt> per call and nothing per iteration.
+ * @par Usage example:
+ * @code
+ * static void SIGSAFE_INTERRUPTIBLE
+ * compress(void *job) { ... }
+ *
+ * if (sigsafe_run_interruptible(compress, &job) == -EINTR) {
+ *     sigsafe_clear_received();
+ *     discard(&job);
+ * }
+ * @endcode
+ * Only code in functions marked SIGSAFE_INTERRUPTIBLE is abandoned. A
+ * signal that arrives while they are in a library call lets that call
+ * finish; the flag stays set, so the next sigsafe wrapper they call returns
+ * <tt>-EINTR</tt>.
+ * @warning Interruptible functions are left at an arbitrary instruction:
+ * they must not take locks, allocate memory, or otherwise leave state that
+ * needs cleaning up. They must only be called through this function.
+ * @return 0 if <tt>fn</tt> returned; <tt>-EINTR</tt> if a signal arrived
+ *         before it did (possibly as it returned); <tt>-ENOMEM</tt>.
+ * @par Availability:
+ * Linux/x86 and Linux/x86_64 with GCC-compatible compilers.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ */
+#define sigsafe_run_interruptible(fn, arg) \
+        sigsafe_run_interruptible_((fn), (arg), \
+                                   __start_sigsafe_interruptible, \
+                                   __stop_sigsafe_interruptible)
+#endif
+
+#if defined(SIGSAFE_HAVE_DEADLINE) || defined(DOXYGEN)
+/**
+ * Chooses the signal deadline timers raise and installs a safe handler for
+ * it. Use a signal reserved for this, such as <tt>SIGRTMIN</tt>; this
+ * replaces any user handler for it.
+ * @par Availability:
+ * Linux.
+ */
+int sigsafe_install_deadline_handler(int signum);
+
+/**
+ * Sets this thread's deadline. Once the <tt>CLOCK_MONOTONIC</tt> time
+ * <tt>deadline</tt> passes, this thread receives the deadline signal, so its
+ * current or next sigsafe call returns <tt>-EINTR</tt> just as for any other
+ * safe signal, and sigsafe_deadline_expired() returns non-zero. This
+ * replaces a <tt>select()</tt> before every <tt>read()</tt> with a timeout:
+ * @code
+ * clock_gettime(CLOCK_MONOTONIC, &deadline);
+ * deadline.tv_sec += 30;
+ * sigsafe_set_deadline(&deadline);
+ * while ((retval = sigsafe_read(fd, buf, count)) == -EINTR) {
+ *     if (sigsafe_deadline_expired()) {
+ *         timed_out();
+ *     }
+ *     handle_signal();
+ * }
+ * @endcode
+ * The thread's timer is created the first time and only rearmed after that,
+ * so moving the deadline costs one system call.
+ * @param deadline  The absolute deadline, or NULL to clear it.
+ * @return 0 on success; <tt>-EINVAL</tt> if no deadline handler is installed
+ *         or the deadline is malformed; <tt>-Exxx</tt> if the timer could
+ *         not be created.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ * @note The signal received flag still needs sigsafe_clear_received().
+ * Setting a new deadline only resets sigsafe_deadline_expired().
+ */
+int sigsafe_set_deadline(const struct timespec *deadline);
+
+/**
+ * Returns non-zero iff this thread's current deadline has passed.
+ * @pre sigsafe_install_tsd has been called in this thread.
+ */
+int sigsafe_deadline_expired(void);
+#endif
+
 /*@}*/
 
 /**
@@ -213,6 +718,64 @@ ssize_t sigsafe_read(int fd, void *buf, size_t count);
 /** Signal-safe <tt>readv(2)</tt>. */
 ssize_t sigsafe_readv(int d, const struct iovec *iov, int iovcnt);
 
+#if defined(SIGSAFE_HAVE_PREAD) || defined(DOXYGEN)
+/**
+ * Signal-safe <tt>pread(2)</tt>.
+ * Offsets here and in the other positional calls are always 64 bits.
+ * @par Availability:
+ * Linux/x86 and Linux/x86_64.
+ */
+ssize_t sigsafe_pread(int fd, void *buf, size_t count, loff_t offset);
+
+/**
+ * Signal-safe <tt>pwrite(2)</tt>.
+ * @par Availability:
+ * As sigsafe_pread().
+ */
+ssize_t sigsafe_pwrite(int fd, const void *buf, size_t count, loff_t offset);
+#endif
+
+#if defined(SIGSAFE_HAVE_PREADV) || defined(DOXYGEN)
+/**
+ * Signal-safe <tt>preadv(2)</tt>.
+ * @par Availability:
+ * As sigsafe_pread(), when the C library had <tt>preadv</tt> at build time.
+ */
+ssize_t sigsafe_preadv(int fd, const struct iovec *iov, int iovcnt,
+                       loff_t offset);
+
+/**
+ * Signal-safe <tt>pwritev(2)</tt>.
+ * @par Availability:
+ * As sigsafe_preadv().
+ */
+ssize_t sigsafe_pwritev(int fd, const struct iovec *iov, int iovcnt,
+                        loff_t offset);
+#endif
+
+#if defined(SIGSAFE_HAVE_PREADV2) || defined(DOXYGEN)
+/**
+ * Signal-safe <tt>preadv2(2)</tt>.
+ * With <tt>RWF_NOWAIT</tt>, this returns <tt>-EAGAIN</tt> rather than
+ * blocking when the data isn't in the page cache; call again without it to
+ * take the (interruptible) slow path. An offset of -1 uses and updates the
+ * file offset.
+ * @par Availability:
+ * As sigsafe_pread(), when the C library had <tt>preadv2</tt> at build
+ * time. Kernels before 4.6 return <tt>-ENOSYS</tt>.
+ */
+ssize_t sigsafe_preadv2(int fd, const struct iovec *iov, int iovcnt,
+                        loff_t offset, int flags);
+
+/**
+ * Signal-safe <tt>pwritev2(2)</tt>.
+ * @par Availability:
+ * As sigsafe_preadv2().
+ */
+ssize_t sigsafe_pwritev2(int fd, const struct iovec *iov, int iovcnt,
+                         loff_t offset, int flags);
+#endif
+
 /** Signal-safe <tt>write(2)</tt>. */
 ssize_t sigsafe_write(int fd, const void *buf, size_t count);
 
@@ -239,6 +802,85 @@ ssize_t sigsafe_recvfrom(int s, void *buf, size_t len, int flags,
 /** Signal-safe <tt>recvmsg(2)</tt>. */
 ssize_t sigsafe_recvmsg(int s, struct msghdr *msg, int flags);
 
+#if defined(SIGSAFE_HAVE_MMSG) || defined(DOXYGEN)
+struct mmsghdr; /* <sys/socket.h> only defines it with _GNU_SOURCE */
+
+/**
+ * Signal-safe <tt>recvmmsg(2)</tt>.
+ * As with the other wrappers, a signal before the kernel is entered gives
+ * <tt>-EINTR</tt>. Once any datagram has been received, the kernel returns
+ * the count rather than <tt>EINTR</tt>, so a partial batch is never lost.
+ * @par Availability:
+ * Linux/x86 and Linux/x86_64, when the C library had <tt>recvmmsg</tt> at
+ * build time.
+ */
+int sigsafe_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen,
+                     int flags, struct timespec *timeout);
+
+/**
+ * Signal-safe <tt>sendmmsg(2)</tt>.
+ * @par Availability:
+ * As sigsafe_recvmmsg().
+ */
+int sigsafe_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen,
+                     int flags);
+#endif
+
+#if defined(SIGSAFE_HAVE_SENDFILE) || defined(DOXYGEN)
+/**
+ * Signal-safe <tt>sendfile(2)</tt>.
+ * The offset is always 64 bits, as with <tt>sendfile64</tt>.
+ * @par Availability:
+ * Linux.
+ */
+ssize_t sigsafe_sendfile(int out_fd, int in_fd, loff_t *offset, size_t count);
+
+/**
+ * Copies data from one file descriptor to another without passing it
+ * through userspace, using sigsafe_sendfile() or, where the kernel won't
+ * sendfile between the two, sigsafe_splice().
+ * Stops after <tt>count</tt> bytes, at end of input, on error, or on a
+ * signal. However it stops, <tt>*copied</tt> is set to the number of bytes
+ * moved, so the caller can handle the signal and continue from there.
+ * @param offset  Where to start reading <tt>in_fd</tt>, advanced as data is
+ *                copied. If NULL, <tt>in_fd</tt>'s file offset is used and
+ *                updated instead, as with <tt>sendfile(2)</tt>.
+ * @param copied  Receives the number of bytes copied by this call.
+ * @return 0 on completion (<tt>*copied</tt> is less than <tt>count</tt> only
+ *         at end of input); <tt>-EINTR</tt> on signal; <tt>-Exxx</tt> on
+ *         error.
+ * @par Availability:
+ * Linux.
+ */
+int sigsafe_copy(int out_fd, int in_fd, loff_t *offset, size_t count,
+                 size_t *copied);
+#endif
+
+#if defined(SIGSAFE_HAVE_SPLICE) || defined(DOXYGEN)
+/**
+ * Signal-safe <tt>splice(2)</tt>.
+ * @par Availability:
+ * Linux 2.6.17+, when the C library had <tt>splice</tt> at build time.
+ */
+ssize_t sigsafe_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+                       size_t len, unsigned int flags);
+
+/**
+ * Signal-safe <tt>tee(2)</tt>.
+ * @par Availability:
+ * As sigsafe_splice().
+ */
+ssize_t sigsafe_tee(int fd_in, int fd_out, size_t len, unsigned int flags);
+
+/**
+ * Signal-safe <tt>vmsplice(2)</tt>.
+ * @par Availability:
+ * As sigsafe_splice().
+ */
+ssize_t sigsafe_vmsplice(int fd, const struct iovec *iov, unsigned long nr_segs,
+                         unsigned int flags);
+#endif
+
 /**
  * Signal-safe <tt>epoll_wait(2)</tt>.
  * @par Availability:
@@ -252,6 +894,35 @@ int sigsafe_epoll_wait(int epfd, struct epoll_event *events, int maxevents,
                        int timeout);
 #endif
 
+#if defined(SIGSAFE_HAVE_EPOLL_PWAIT2) || defined(DOXYGEN)
+/**
+ * Signal-safe <tt>epoll_pwait2(2)</tt>, without the signal mask.
+ * Like sigsafe_epoll_wait(), but with a nanosecond timeout; NULL waits
+ * forever. On kernels without <tt>epoll_pwait2</tt>, falls back to
+ * sigsafe_epoll_wait() with the timeout rounded up to whole milliseconds.
+ * @par Availability:
+ * Linux/x86 and Linux/x86_64 with epoll.
+ */
+int sigsafe_epoll_pwait2(int epfd, struct epoll_event *events, int maxevents,
+                         const struct timespec *timeout);
+#endif
+
+#if defined(SIGSAFE_HAVE_IO_URING) || defined(DOXYGEN)
+/**
+ * Signal-safe <tt>io_uring_enter(2)</tt>.
+ * @ingroup sigsafe_syscalls
+ * With <tt>IORING_ENTER_GETEVENTS</tt>, a signal before the kernel is
+ * entered returns <tt>-EINTR</tt> without submitting anything; the
+ * submission queue entries stay queued for the next call.
+ * @par Availability:
+ * Linux/x86 and Linux/x86_64, when built with <tt>linux/io_uring.h</tt>.
+ * Kernels before 5.1 return <tt>-ENOSYS</tt>.
+ */
+int sigsafe_io_uring_enter(unsigned int fd, unsigned int to_submit,
+                           unsigned int min_complete, unsigned int flags,
+                           const sigset_t *sig, size_t sigsz);
+#endif
+
 /**
  * Signal-safe <tt>kevent(2)</tt>.
  * @ingroup sigsafe_syscalls
@@ -280,6 +951,19 @@ int sigsafe_select(int nfds, fd_set *readfds, fd_set *writefds,
                    fd_set *errorfds, struct timeval *timeout);
 #endif
 
+/**
+ * Signal-safe <tt>pselect(2)</tt>, without the signal mask.
+ * The mask exists to close the race sigsafe already closes. Unlike
+ * sigsafe_select(), the timeout has nanosecond resolution and is never
+ * modified.
+ * @par Availability:
+ * Linux/x86 and Linux/x86_64 (2.6.16+).
+ */
+#if defined(SIGSAFE_HAVE_PSELECT) || defined(DOXYGEN)
+int sigsafe_pselect(int nfds, fd_set *readfds, fd_set *writefds,
+                    fd_set *errorfds, const struct timespec *timeout);
+#endif
+
 /**
  * Signal-safe <tt>poll(2)</tt>.
  * @par Availability:
@@ -291,6 +975,18 @@ int sigsafe_select(int nfds, fd_set *readfds, fd_set *writefds,
 int sigsafe_poll(struct pollfd *ufds, unsigned int nfds, int timeout);
 #endif
 
+/**
+ * Signal-safe <tt>ppoll(2)</tt>, without the signal mask.
+ * Like sigsafe_poll(), but with a nanosecond timeout; NULL waits forever.
+ * The timeout is never modified.
+ * @par Availability:
+ * Linux/x86 and Linux/x86_64 (2.6.16+).
+ */
+#if defined(SIGSAFE_HAVE_PPOLL) || defined(DOXYGEN)
+int sigsafe_ppoll(struct pollfd *ufds, unsigned int nfds,
+                  const struct timespec *timeout);
+#endif
+
 /** Signal-safe <tt>wait4(2)</tt>. */
 int sigsafe_wait4(pid_t wpid, int *status, int options, struct rusage *rusage);
 
@@ -312,9 +1008,332 @@ int sigsafe_connect(int sockfd, const struct sockaddr *serv_addr,
  */
 int sigsafe_nanosleep(const struct timespec *rqtp, struct timespec *rmtp);
 
+#if defined(SIGSAFE_HAVE_CLOCK_NANOSLEEP) || defined(DOXYGEN)
+/**
+ * Signal-safe <tt>clock_nanosleep(2)</tt>.
+ * With <tt>TIMER_ABSTIME</tt>, a periodic loop can sleep until each tick's
+ * deadline and never accumulate drift; <tt>rmtp</tt> is not touched then.
+ * Note that, like the other wrappers and unlike the C library's function,
+ * this returns <tt>-Exxx</tt> on failure.
+ * @par Availability:
+ * Linux.
+ */
+int sigsafe_clock_nanosleep(clockid_t clock_id, int flags,
+                            const struct timespec *rqtp,
+                            struct timespec *rmtp);
+#endif
+
 int sigsafe_sigsuspend(const sigset_t*);
 int sigsafe_pause(void);
 
+#ifdef SIGSAFE_HAVE_SYSCALL
+/**
+ * Signal-safe <tt>syscall(2)</tt>, for system calls without their own
+ * wrapper. Takes the system call number and up to six <tt>long</tt>-sized
+ * arguments, and returns the kernel's result directly: a negative error
+ * number on failure.
+ * @par Availability:
+ * Linux/x86 and Linux/x86_64.
+ * @note As with <tt>syscall(2)</tt>, arguments are passed exactly as the
+ * kernel takes them; 64-bit offsets on Linux/x86, for example, must be
+ * split into two arguments by the caller.
+ */
+long sigsafe_syscall(long number, ...);
+
+/** One system call for sigsafe_batch(). */
+struct sigsafe_op {
+    long number;    /**< the system call number, as for sigsafe_syscall() */
+    long args[6];   /**< its arguments; unused ones are ignored */
+    long result;    /**< set by sigsafe_batch() */
+};
+
+/**
+ * Runs several system calls back to back, as with sigsafe_syscall(), but
+ * finding the thread-specific data only once. The signal received flag is
+ * still checked immediately before each one enters the kernel.
+ * @par Usage example:
+ * @code
+ * struct sigsafe_op ops[3] = {
+ *     { SYS_write,  { fd, (long) hdr, hdrlen } },
+ *     { SYS_writev, { fd, (long) iov, iovcnt } },
+ *     { SYS_read,   { fd, (long) buf, buflen } },
+ * };
+ * n = sigsafe_batch(ops, 3);
+ * @endcode
+ * @return the number of operations completed; each has its kernel result,
+ * possibly a negative error number, in <tt>result</tt>. Stops early after
+ * an operation fails, or before entering one when a signal has been
+ * received, in which case that operation's <tt>result</tt> is
+ * <tt>-EINTR</tt> and it had no effect.
+ * @par Availability:
+ * Linux/x86 and Linux/x86_64.
+ */
+int sigsafe_batch(struct sigsafe_op *ops, int n);
+#endif
+
+/*@}*/
+
+#if defined(SIGSAFE_HAVE_IO_URING) || defined(DOXYGEN)
+/**
+ * @defgroup sigsafe_uring Signal-safe io_uring helpers
+ * A minimal io_uring ring built on sigsafe_io_uring_enter(), so a thread
+ * waiting for completions returns <tt>-EINTR</tt> on a safe signal just as
+ * one blocked in sigsafe_read() does, with no eventfd needed to wake it.
+ * Use it from one thread at a time. Include <tt>linux/io_uring.h</tt> to
+ * fill in submission queue entries.
+ * @par Usage example:
+ * @code
+ * struct io_uring_sqe *sqe = sigsafe_uring_get_sqe(&ring);
+ * memset(sqe, 0, sizeof(*sqe));
+ * sqe->opcode = IORING_OP_READ;
+ * sqe->fd = fd;
+ * sqe->addr = (unsigned long) buf;
+ * sqe->len = len;
+ * sqe->off = -1;
+ * while ((n = sigsafe_uring_wait(&ring, cqes, 16)) == -EINTR) {
+ *     handle_signal();
+ * }
+ * @endcode
+ */
+/*@{*/
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/** A mapped io_uring instance. Treat the members as private. */
+struct sigsafe_uring {
+    int fd;
+    unsigned int *sq_head, *sq_tail, *sq_array;
+    unsigned int sq_mask, sq_entries;
+    unsigned int sqe_tail;      /**< end of entries handed out so far */
+    struct io_uring_sqe *sqes;
+    unsigned int *cq_head, *cq_tail;
+    unsigned int cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map, *cq_map;
+    size_t sq_map_size, cq_map_size, sqes_size;
+};
+
+/**
+ * Creates a ring with at least <tt>entries</tt> submission queue entries.
+ * @return 0 on success; <tt>-Exxx</tt> on failure.
+ */
+int sigsafe_uring_init(struct sigsafe_uring *ring, unsigned int entries);
+
+/** Unmaps and closes the ring. */
+void sigsafe_uring_destroy(struct sigsafe_uring *ring);
+
+/**
+ * Returns the next free submission queue entry, or NULL if the queue is
+ * full. The entry is submitted by the next sigsafe_uring_submit() or
+ * sigsafe_uring_wait().
+ */
+struct io_uring_sqe *sigsafe_uring_get_sqe(struct sigsafe_uring *ring);
+
+/**
+ * Submits all entries gotten so far without waiting.
+ * @return the number submitted; <tt>-EINTR</tt> if a signal arrived first,
+ *         in which case they stay queued; <tt>-Exxx</tt> on error.
+ */
+int sigsafe_uring_submit(struct sigsafe_uring *ring);
+
+/**
+ * Copies up to <tt>max</tt> completions into <tt>cqes</tt> without waiting.
+ * @return the number copied.
+ */
+int sigsafe_uring_reap(struct sigsafe_uring *ring, struct io_uring_cqe *cqes,
+                       unsigned int max);
+
+/**
+ * Submits all entries gotten so far, then waits for and copies out between
+ * one and <tt>max</tt> completions.
+ * @return the number copied; <tt>-EINTR</tt> on signal; <tt>-Exxx</tt> on
+ *         error.
+ */
+int sigsafe_uring_wait(struct sigsafe_uring *ring, struct io_uring_cqe *cqes,
+                       unsigned int max);
+
+/*@}*/
+#endif
+
+/**
+ * @defgroup sigsafe_reactor Signal-safe event loop
+ * A small single-threaded reactor: file descriptor readiness callbacks,
+ * one-shot timers, and signals as ordinary callbacks, with no self-pipe.
+ * It waits with sigsafe_epoll_wait() where epoll is available and
+ * sigsafe_poll() or sigsafe_select() elsewhere. A signal arriving at any
+ * point in an iteration, even just before the wait, cuts the wait short;
+ * the reactor then runs that signal's callbacks. Apart from the wait, an
+ * iteration makes no system calls. Registrations live in structures you
+ * own; treat their members as private.
+ * @par Usage example:
+ * @code
+ * sigsafe_install_handler(SIGTERM, NULL);
+ * sigsafe_install_tsd(0, NULL);
+ * sigsafe_reactor_init(&r);
+ * sigsafe_reactor_add_fd(&r, &conn, fd, SIGSAFE_REACTOR_READ, on_read, c);
+ * sigsafe_reactor_add_signal(&r, &term, SIGTERM, on_term, &r);
+ * sigsafe_reactor_run(&r);  // until on_term calls sigsafe_reactor_stop()
+ * @endcode
+ * @note Use a reactor from one thread, with TSD installed. Signals reach
+ * it only if they have safe handlers installed with
+ * sigsafe_install_handler(); the reactor takes every signal its thread
+ * records, so don't also use deferred handlers or
+ * sigsafe_fetch_received() in that thread.
+ */
+/*@{*/
+
+#define SIGSAFE_REACTOR_READ  0x1 /**< readable, hung up, or in error */
+#define SIGSAFE_REACTOR_WRITE 0x2 /**< writable or in error */
+
+struct sigsafe_reactor;
+
+/**
+ * @typedef sigsafe_reactor_io_handler_t
+ * Called with the descriptor, the SIGSAFE_REACTOR_* events which are ready,
+ * and the argument given to sigsafe_reactor_add_fd().
+ */
+typedef void (*sigsafe_reactor_io_handler_t)(int, int, void*);
+
+/**
+ * @typedef sigsafe_reactor_timer_handler_t
+ * Called with the argument given to sigsafe_reactor_add_timer().
+ */
+typedef void (*sigsafe_reactor_timer_handler_t)(void*);
+
+/**
+ * @typedef sigsafe_reactor_signal_handler_t
+ * Called with the signal number, how many times it arrived since the last
+ * call, and the argument given to sigsafe_reactor_add_signal().
+ */
+typedef void (*sigsafe_reactor_signal_handler_t)(int, unsigned int, void*);
+
+/** A file descriptor watched by a reactor. */
+struct sigsafe_reactor_fd {
+    int fd;
+    int events;
+    sigsafe_reactor_io_handler_t handler;
+    void *arg;
+    int index;                  /**< slot in the poll/select arrays */
+    int revents;                /**< poll/select only */
+};
+
+/** A one-shot timer. */
+struct sigsafe_reactor_timer {
+    long long deadline_ns;      /**< CLOCK_MONOTONIC */
+    sigsafe_reactor_timer_handler_t handler;
+    void *arg;
+    int heap_index;             /**< -1 unless waiting in the heap */
+    int due;                    /**< expired and about to run */
+    struct sigsafe_reactor_timer *next_due;
+};
+
+/** A signal callback. */
+struct sigsafe_reactor_signal {
+    int signum;
+    sigsafe_reactor_signal_handler_t handler;
+    void *arg;
+    struct sigsafe_reactor_signal *next;
+};
+
+/** An event loop. */
+struct sigsafe_reactor {
+    int epfd;                   /**< epoll only */
+    void *events;               /**< epoll only: its struct epoll_event[] */
+    struct sigsafe_reactor_fd **fds; /**< registered, by index */
+    void *pfds;                 /**< poll only: its struct pollfd[] */
+    int nfds, fds_cap;
+    struct sigsafe_reactor_fd **ready; /**< poll/select: this pass's */
+    int nready, next_ready;
+    struct sigsafe_reactor_timer **heap; /**< armed timers, soonest first */
+    int nheap, heap_cap;
+    struct sigsafe_reactor_signal *signals;
+    long long now_ns;           /**< CLOCK_MONOTONIC as of the last wait */
+    int stopping;
+};
+
+/**
+ * Creates an empty reactor.
+ * @return 0 on success; <tt>-Exxx</tt> on failure.
+ */
+int sigsafe_reactor_init(struct sigsafe_reactor *r);
+
+/** Frees the reactor's resources. Registrations are simply forgotten. */
+void sigsafe_reactor_destroy(struct sigsafe_reactor *r);
+
+/**
+ * Starts watching <tt>fd</tt> for <tt>events</tt>, a mask of
+ * SIGSAFE_REACTOR_READ and SIGSAFE_REACTOR_WRITE, with <tt>h</tt> as the
+ * registration. Readiness is level-triggered.
+ * @return 0 on success; <tt>-Exxx</tt> on failure.
+ */
+int sigsafe_reactor_add_fd(struct sigsafe_reactor *r,
+                           struct sigsafe_reactor_fd *h, int fd, int events,
+                           sigsafe_reactor_io_handler_t handler, void *arg);
+
+/**
+ * Changes the events a registered descriptor is watched for.
+ * @return 0 on success; <tt>-Exxx</tt> on failure.
+ */
+int sigsafe_reactor_modify_fd(struct sigsafe_reactor *r,
+                              struct sigsafe_reactor_fd *h, int events);
+
+/**
+ * Stops watching a descriptor. Safe from any callback, even for a
+ * descriptor ready in the same pass; its callback then doesn't run. Remove
+ * a descriptor before closing it.
+ */
+void sigsafe_reactor_remove_fd(struct sigsafe_reactor *r,
+                               struct sigsafe_reactor_fd *h);
+
+/**
+ * Arms a one-shot timer to run <tt>delay</tt> after the reactor's last wait
+ * returned. A callback may re-arm its own timer; one with no delay runs on
+ * the next pass rather than this one.
+ * @return 0 on success; <tt>-ENOMEM</tt>.
+ * @pre <tt>t</tt> is not armed.
+ */
+int sigsafe_reactor_add_timer(struct sigsafe_reactor *r,
+                              struct sigsafe_reactor_timer *t,
+                              const struct timespec *delay,
+                              sigsafe_reactor_timer_handler_t handler,
+                              void *arg);
+
+/** Disarms a timer, if armed. Safe from any callback. */
+void sigsafe_reactor_cancel_timer(struct sigsafe_reactor *r,
+                                  struct sigsafe_reactor_timer *t);
+
+/**
+ * Runs <tt>handler</tt> whenever <tt>signum</tt> has arrived in the
+ * reactor's thread. Several callbacks may share a signal. The reactor runs
+ * deferred handlers (see sigsafe_dispatch_pending()) too, and leaves other
+ * signals pending for sigsafe_fetch_received().
+ */
+void sigsafe_reactor_add_signal(struct sigsafe_reactor *r,
+                                struct sigsafe_reactor_signal *s, int signum,
+                                sigsafe_reactor_signal_handler_t handler,
+                                void *arg);
+
+/** Removes a signal callback. */
+void sigsafe_reactor_remove_signal(struct sigsafe_reactor *r,
+                                   struct sigsafe_reactor_signal *s);
+
+/**
+ * Waits once, unless <tt>block</tt> is 0, then runs the callbacks for
+ * whatever signals, timers, and descriptors are ready, in that order.
+ * @return the number of callbacks run; <tt>-Exxx</tt> if the wait failed.
+ */
+int sigsafe_reactor_run_once(struct sigsafe_reactor *r, int block);
+
+/**
+ * Runs iterations until sigsafe_reactor_stop() is called.
+ * @return 0 once stopped; <tt>-Exxx</tt> if a wait failed.
+ */
+int sigsafe_reactor_run(struct sigsafe_reactor *r);
+
+/** Makes sigsafe_reactor_run() return after the current iteration. */
+void sigsafe_reactor_stop(struct sigsafe_reactor *r);
+
 /*@}*/
 
 #ifdef __cplusplus
@@ -0,0 +1,66 @@
+/** @file
+ * Signal-safe file descriptor to file descriptor copying on Linux.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#define _GNU_SOURCE /* for SPLICE_F_MOVE */
+#include "sigsafe_internal.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/** The most Linux will transfer in one sendfile or splice call. */
+#define MAX_CHUNK 0x7ffff000
+
+#ifdef SIGSAFE_HAVE_SPLICE
+static int
+is_pipe(int fd)
+{
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+#endif
+
+int
+sigsafe_copy(int out_fd, int in_fd, loff_t *offset, size_t count,
+             size_t *copied)
+{
+#ifdef SIGSAFE_HAVE_SPLICE
+    int use_splice = 0;
+#endif
+    ssize_t retval;
+
+    *copied = 0;
+    while (*copied < count) {
+        size_t len = count - *copied;
+        if (len > MAX_CHUNK) {
+            len = MAX_CHUNK;
+        }
+#ifdef SIGSAFE_HAVE_SPLICE
+        if (use_splice) {
+            retval = sigsafe_splice(in_fd, offset, out_fd, NULL, len,
+                                    SPLICE_F_MOVE);
+        } else
+#endif
+        retval = sigsafe_sendfile(out_fd, in_fd, offset, len);
+#ifdef SIGSAFE_HAVE_SPLICE
+        /* sendfile won't read from a pipe (or, before 2.6.33, write to one). */
+        if (!use_splice && retval == -EINVAL && *copied == 0
+            && (is_pipe(in_fd) || is_pipe(out_fd))) {
+            use_splice = 1;
+            continue;
+        }
+#endif
+        if (retval < 0) {
+            return retval;
+        } else if (retval == 0) {
+            return 0; /* end of input */
+        }
+        *copied += retval;
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+/** @file
+ * Inline versions of the most common signal-safe system call wrappers.
+ * These behave exactly like the functions of the same names without
+ * <tt>_inline</tt>, but the check and the system call are expanded into the
+ * caller. The compiler can keep values in registers across them and there
+ * is no call, PLT entry, or register shuffling per operation.
+ *
+ * Each expansion notes its own jump region in the <tt>sigsafe_jmptab</tt>
+ * section, and a constructor in every file including this header hands the
+ * module's section to the signal handler.
+ *
+ * Currently, they are only inline on x86_64 Linux with GCC-compatible
+ * compilers, and only for single-threaded code or libraries built with
+ * <tt>tls=1</tt>. Elsewhere they are plain calls to the out-of-line wrappers.
+ * sigsafe_signal_pending_inline() needs no assembly, so it is inline on any
+ * ELF platform under the same conditions.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#ifndef SIGSAFE_INLINE_H
+#define SIGSAFE_INLINE_H
+
+#include <sigsafe.h>
+
+#if defined(__GNUC__) && defined(__ELF__) \
+    && (defined(SIGSAFE_HAVE_TLS) \
+        || !(defined(_REENTRANT) || defined(_THREAD_SAFE)))
+#define SIGSAFE_INLINE_TSD
+#endif
+
+#if defined(SIGSAFE_INLINE_TSD) && defined(__x86_64__) && defined(__linux__)
+#define SIGSAFE_INLINE_ASM
+#endif
+
+#ifdef SIGSAFE_INLINE_ASM
+#include <errno.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef SIGSAFE_INLINE_TSD
+/*
+ * @internal
+ * The library's thread-specific data. Its first member is the
+ * signal_received flag, which is all these wrappers look at.
+ */
+struct sigsafe_tsd_;
+#if defined(_REENTRANT) || defined(_THREAD_SAFE)
+extern __thread struct sigsafe_tsd_ *sigsafe_data_
+        __attribute__ ((tls_model ("initial-exec")));
+#define SIGSAFE_INLINE_TSD_ sigsafe_data_
+#else
+extern struct sigsafe_tsd_ ** const sigsafe_data_addr_;
+#define SIGSAFE_INLINE_TSD_ (*sigsafe_data_addr_)
+#endif
+
+#ifdef SIGSAFE_HAVE_LAZY_TSD
+/** @internal Installs TSD if sigsafe_enable_lazy_tsd() asked; the flag. */
+const volatile sig_atomic_t *sigsafe_lazy_flag_(void);
+#endif
+
+/**
+ * @internal
+ * Returns the flag the wrappers check before entering the kernel. Threads
+ * without TSD get it installed if sigsafe_enable_lazy_tsd() was called, or
+ * else a flag that is never set; the handler ignores signals to them anyway.
+ */
+static __inline__ const volatile sig_atomic_t *
+sigsafe_inline_flag_(void)
+{
+    const volatile sig_atomic_t *flag =
+            (const volatile sig_atomic_t*) SIGSAFE_INLINE_TSD_;
+#ifdef SIGSAFE_HAVE_LAZY_TSD
+    return (flag != NULL) ? flag : sigsafe_lazy_flag_();
+#else
+    static const volatile sig_atomic_t never = 0;
+    return (flag != NULL) ? flag : &never;
+#endif
+}
+
+/**
+ * Inline sigsafe_signal_pending(): the thread-local pointer and the flag,
+ * with no call. A thread without TSD has nothing pending; only the wrappers
+ * install it lazily.
+ */
+static __inline__ int
+sigsafe_signal_pending_inline(void)
+{
+    const volatile sig_atomic_t *flag =
+            (const volatile sig_atomic_t*) SIGSAFE_INLINE_TSD_;
+
+    return flag != NULL && *flag != 0;
+}
+#else
+static __inline__ int
+sigsafe_signal_pending_inline(void)
+{ return sigsafe_signal_pending(); }
+#endif /* SIGSAFE_INLINE_TSD */
+
+#ifdef SIGSAFE_INLINE_ASM
+
+/** @internal Registers a module's inline jump regions with the handler. */
+void sigsafe_register_jmptab_(void *start, void *stop);
+
+extern char __start_sigsafe_jmptab[]
+        __attribute__ ((weak, visibility ("hidden")));
+extern char __stop_sigsafe_jmptab[]
+        __attribute__ ((weak, visibility ("hidden")));
+
+/* Make sure the section exists, so the bounds above are defined. */
+__asm__ (".pushsection sigsafe_jmptab,\"aw\",@progbits\n\t"
+         ".popsection");
+
+static void __attribute__ ((constructor, unused))
+sigsafe_register_inline_(void)
+{
+    sigsafe_register_jmptab_(__start_sigsafe_jmptab, __stop_sigsafe_jmptab);
+}
+
+/*
+ * 1: is minjmp, 2: is maxjmp, and 3: is jmpto, exactly as in the out-of-line
+ * wrappers. %rax holds the system call number on entry to the region, so a
+ * restarted system call comes back to 2: as usual.
+ */
+#define SIGSAFE_INLINE_BODY_                                                \
+        "1:\tcmpl $0,(%[flag])\n\t"                                         \
+        "jne 3f\n"                                                          \
+        "2:\tsyscall\n\t"                                                   \
+        "jmp 4f\n"                                                          \
+        "3:\tmovq %[eintr],%%rax\n"                                         \
+        "4:\n\t"                                                            \
+        ".pushsection sigsafe_jmptab,\"aw\",@progbits\n\t"                  \
+        ".balign 8\n\t"                                                     \
+        ".quad 1b, 2b, 3b\n\t"                                              \
+        ".popsection"
+
+/** @internal A signal-safe system call of up to three arguments. */
+static __inline__ long
+sigsafe_inline_syscall3_(long nr, long a1, long a2, long a3)
+{
+    long ret;
+    __asm__ __volatile__ (SIGSAFE_INLINE_BODY_
+                          : "=a" (ret)
+                          : "0" (nr), "D" (a1), "S" (a2), "d" (a3),
+                            [flag] "r" (sigsafe_inline_flag_()),
+                            [eintr] "i" (-EINTR)
+                          : "rcx", "r11", "memory", "cc");
+    return ret;
+}
+
+/** @internal A signal-safe system call of up to six arguments. */
+static __inline__ long
+sigsafe_inline_syscall6_(long nr, long a1, long a2, long a3, long a4,
+                         long a5, long a6)
+{
+    long ret;
+    register long r10 __asm__ ("r10") = a4;
+    register long r8  __asm__ ("r8")  = a5;
+    register long r9  __asm__ ("r9")  = a6;
+    __asm__ __volatile__ (SIGSAFE_INLINE_BODY_
+                          : "=a" (ret)
+                          : "0" (nr), "D" (a1), "S" (a2), "d" (a3),
+                            "r" (r10), "r" (r8), "r" (r9),
+                            [flag] "r" (sigsafe_inline_flag_()),
+                            [eintr] "i" (-EINTR)
+                          : "rcx", "r11", "memory", "cc");
+    return ret;
+}
+
+/** Inline sigsafe_read(). */
+static __inline__ ssize_t
+sigsafe_read_inline(int fd, void *buf, size_t count)
+{
+    return sigsafe_inline_syscall3_(SYS_read, fd, (long) buf, count);
+}
+
+/** Inline sigsafe_write(). */
+static __inline__ ssize_t
+sigsafe_write_inline(int fd, const void *buf, size_t count)
+{
+    return sigsafe_inline_syscall3_(SYS_write, fd, (long) buf, count);
+}
+
+/** Inline sigsafe_readv(). */
+static __inline__ ssize_t
+sigsafe_readv_inline(int d, const struct iovec *iov, int iovcnt)
+{
+    return sigsafe_inline_syscall3_(SYS_readv, d, (long) iov, iovcnt);
+}
+
+/** Inline sigsafe_writev(). */
+static __inline__ ssize_t
+sigsafe_writev_inline(int d, const struct iovec *iov, int iovcnt)
+{
+    return sigsafe_inline_syscall3_(SYS_writev, d, (long) iov, iovcnt);
+}
+
+/** Inline sigsafe_recvfrom(). */
+static __inline__ ssize_t
+sigsafe_recvfrom_inline(int s, void *buf, size_t len, int flags,
+                        struct sockaddr *from, socklen_t *fromlen)
+{
+    return sigsafe_inline_syscall6_(SYS_recvfrom, s, (long) buf, len, flags,
+                                    (long) from, (long) fromlen);
+}
+
+/** Inline sigsafe_sendto(). */
+static __inline__ ssize_t
+sigsafe_sendto_inline(int s, const void *msg, size_t len, int flags,
+                      const struct sockaddr *to, socklen_t tolen)
+{
+    return sigsafe_inline_syscall6_(SYS_sendto, s, (long) msg, len, flags,
+                                    (long) to, tolen);
+}
+
+/** Inline sigsafe_recv(). */
+static __inline__ ssize_t
+sigsafe_recv_inline(int s, void *buf, size_t len, int flags)
+{
+    return sigsafe_recvfrom_inline(s, buf, len, flags, NULL, NULL);
+}
+
+/** Inline sigsafe_send(). */
+static __inline__ ssize_t
+sigsafe_send_inline(int s, const void *msg, size_t len, int flags)
+{
+    return sigsafe_sendto_inline(s, msg, len, flags, NULL, 0);
+}
+
+#else /* !SIGSAFE_INLINE_ASM */
+
+static __inline__ ssize_t
+sigsafe_read_inline(int fd, void *buf, size_t count)
+{ return sigsafe_read(fd, buf, count); }
+
+static __inline__ ssize_t
+sigsafe_write_inline(int fd, const void *buf, size_t count)
+{ return sigsafe_write(fd, buf, count); }
+
+static __inline__ ssize_t
+sigsafe_readv_inline(int d, const struct iovec *iov, int iovcnt)
+{ return sigsafe_readv(d, iov, iovcnt); }
+
+static __inline__ ssize_t
+sigsafe_writev_inline(int d, const struct iovec *iov, int iovcnt)
+{ return sigsafe_writev(d, iov, iovcnt); }
+
+static __inline__ ssize_t
+sigsafe_recvfrom_inline(int s, void *buf, size_t len, int flags,
+                        struct sockaddr *from, socklen_t *fromlen)
+{ return sigsafe_recvfrom(s, buf, len, flags, from, fromlen); }
+
+static __inline__ ssize_t
+sigsafe_sendto_inline(int s, const void *msg, size_t len, int flags,
+                      const struct sockaddr *to, socklen_t tolen)
+{ return sigsafe_sendto(s, msg, len, flags, to, tolen); }
+
+static __inline__ ssize_t
+sigsafe_recv_inline(int s, void *buf, size_t len, int flags)
+{ return sigsafe_recv(s, buf, len, flags); }
+
+static __inline__ ssize_t
+sigsafe_send_inline(int s, const void *msg, size_t len, int flags)
+{ return sigsafe_send(s, msg, len, flags); }
+
+#endif /* SIGSAFE_INLINE_ASM */
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+#endif /* !SIGSAFE_INLINE_H */
@@ -8,6 +8,7 @@
  */
 
 #include "sigsafe.h"
+#include <limits.h>
 
 #ifndef SIGSAFE_INTERNAL_H
 #define SIGSAFE_INTERNAL_H
@@ -53,12 +54,126 @@
 #error Not sure how many signals you have
 #endif
 
-/** Thread-specific data. */
+/**
+ * @define SIGSAFE_TSD_KEY
+ * Defined when the thread-specific data is found through
+ * <tt>pthread_getspecific(sigsafe_key_)</tt>. Multi-threaded builds with
+ * <tt>SIGSAFE_HAVE_TLS</tt> instead keep it in an initial-exec
+ * <tt>__thread</tt> pointer, <tt>sigsafe_data_</tt>, just like the
+ * single-threaded builds' global. (The key is still created there, but only
+ * so the destructor runs at thread exit.)
+ */
+#if defined(_THREAD_SAFE) && !defined(SIGSAFE_HAVE_TLS)
+#define SIGSAFE_TSD_KEY
+#endif
+
+/**
+ * @define SIGSAFE_ATOMICS
+ * Defined when the compiler has GCC 4.7's <tt>__atomic</tt> builtins. The
+ * core has a fallback for each use; the Linux-only features, which keep
+ * lock-free state shared with other threads and with the signal handler,
+ * require them.
+ */
+#if defined(__GNUC__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define SIGSAFE_ATOMICS
+#elif defined(SIGSAFE_HAVE_INTERRUPT) || defined(SIGSAFE_HAVE_DEADLINE) \
+    || defined(SIGSAFE_HAVE_IO_URING) || defined(SIGSAFE_HAVE_LAZY_TSD)
+#error "this configuration needs the GCC 4.7 __atomic builtins"
+#endif
+
+/** Bits in each word of sigsafe_tsd_::pending. */
+#define SIGSAFE_PENDING_BITS (sizeof(unsigned long) * CHAR_BIT)
+
+/** Words in sigsafe_tsd_::pending. */
+#define SIGSAFE_PENDING_WORDS \
+        ((SIGSAFE_SIGMAX + SIGSAFE_PENDING_BITS - 1) / SIGSAFE_PENDING_BITS)
+
+/**
+ * A thread's ring of saved signal information. The signal handler is the
+ * only producer and the thread itself the only consumer, and the handler
+ * always runs to completion before the thread resumes, so neither needs a
+ * lock.
+ */
+struct sigsafe_siginfo_queue_ {
+    unsigned int mask;              /**< size - 1; the size is a power of 2 */
+    volatile unsigned int head;     /**< next to drain; only the thread writes */
+    volatile unsigned int tail;     /**< next to fill; only the handler writes */
+    volatile unsigned long dropped; /**< signals lost to a full ring */
+    struct sigsafe_siginfo entries[1];
+};
+
+#ifdef SIGSAFE_HAVE_INTERRUPT
+/**
+ * An entry in the registry of threads with TSD. Entries are never freed; a
+ * thread's entry is marked free when it exits and reused by a later thread.
+ * Each takes a whole cache line, so a thread publishing its watchdog
+ * deadline doesn't disturb its neighbors.
+ */
+struct sigsafe_thread_ {
+    volatile pid_t tid;             /**< kernel thread id, or 0 if free */
+    /**
+     * When the watchdog should interrupt this thread, 0 for never, or -1
+     * once it has. Only accessed atomically; aligned so that is one
+     * instruction on i386 too.
+     */
+    volatile long long deadline_ns __attribute__ ((aligned (8)));
+    /** Signals routed to this thread, in the layout of sigsafe_tsd_::pending. */
+    volatile unsigned long owned[SIGSAFE_PENDING_WORDS];
+    struct sigsafe_thread_ *next;
+} __attribute__ ((aligned (64)));
+
+/** The registry; entries are pushed on the front and never removed. */
+INTERNAL_DEC struct sigsafe_thread_ * volatile sigsafe_threads_;
+
+/** The signal sigsafe_interrupt_thread sends; 0 until chosen. */
+INTERNAL_DEC int sigsafe_interrupt_signum_;
+#endif
+
+/**
+ * Thread-specific data.
+ * The assembly wrappers only ever look at the first member.
+ */
 struct sigsafe_tsd_ {
     /** Non-zero iff signal received since last sigsafe_clear_received. */
     volatile sig_atomic_t signal_received;
     intptr_t user_data;
     void (*destructor)(intptr_t);
+    /**
+     * Bit <tt>signum - 1</tt> is set iff that signal was received since the
+     * last sigsafe_fetch_received.
+     */
+    volatile unsigned long pending[SIGSAFE_PENDING_WORDS];
+    /** Times each signal (by <tt>signum - 1</tt>) was received since then. */
+    volatile unsigned int counts[SIGSAFE_SIGMAX];
+    /** Saved signal information, or NULL if not requested. */
+    struct sigsafe_siginfo_queue_ *queue;
+    /** Non-zero iff this lives in a caller's sigsafe_tsd_storage. */
+    int caller_storage;
+#ifdef SIGSAFE_HAVE_LAZY_TSD
+    /** Non-zero iff a wrapper installed this; the thread may replace it. */
+    int lazy;
+#endif
+#ifdef SIGSAFE_HAVE_INTERRUPT
+    /** This thread's registry entry. */
+    struct sigsafe_thread_ *thread;
+#endif
+#ifdef SIGSAFE_HAVE_DEADLINE
+    /** Kernel timer id for sigsafe_set_deadline, or -1 until first used. */
+    int deadline_timer;
+    /**
+     * The armed deadline in CLOCK_MONOTONIC nanoseconds, or 0 if none. Read
+     * by the signal handler, so only accessed atomically; aligned so that is
+     * one instruction on i386 too.
+     */
+    volatile long long deadline_ns __attribute__ ((aligned (8)));
+    /** Non-zero iff the armed deadline's timer has fired. */
+    volatile sig_atomic_t deadline_expired;
+#endif
+#ifdef SIGSAFE_HAVE_INTERRUPTIBLE
+    /** Where the innermost sigsafe_run_interruptible unwinds to, or NULL. */
+    jmp_buf *interrupt_env;
+#endif
 };
 
 struct sigsafe_syscall_ {
@@ -69,6 +184,65 @@ struct sigsafe_syscall_ {
 
 INTERNAL_DEC struct sigsafe_syscall_ sigsafe_syscalls_[];
 
+/**
+ * A jump region as the signal handler sees it: the labels of a
+ * sigsafe_syscall_ resolved to the values the instruction pointer takes.
+ */
+struct sigsafe_jmp_ {
+    void *minjmp;
+    void *maxjmp;
+    void *jmpto;
+};
+
+/**
+ * @define SIGSAFE_LABEL_ADDR
+ * Resolves a label from sigsafe_syscalls_ to a code address.
+ * @define SIGSAFE_MAXJMP_SLOP
+ * Added to the resolved maxjmp.
+ *
+ * XXX
+ *
+ * There are two funny things about ia64:
+ * - the extra dereference; why? function pointers on ia64 are just
+ *   like this?
+ * - the "+ 1" in the maxjmp. It's clearly something to do with how
+ *   the break.i instruction is bundled, but I don't completely get
+ *   it.
+ */
+#ifdef __ia64__
+#define SIGSAFE_LABEL_ADDR(label) (* (void**) (label))
+#define SIGSAFE_MAXJMP_SLOP 1
+#else
+#define SIGSAFE_LABEL_ADDR(label) ((void*) (label))
+#define SIGSAFE_MAXJMP_SLOP 0
+#endif
+
+/**
+ * Finds the jump region containing <tt>ip</tt>, if any.
+ * Looks in the library's own wrappers, then in the tables of inline wrappers
+ * registered through sigsafe_register_jmptab_(). Addresses outside the span
+ * of a table are rejected with a single range check; others take a binary
+ * search. Async signal-safe.
+ * @pre sigsafe's initialization has run (guaranteed once a handler has been
+ *      installed).
+ */
+HIDDEN_DEC const struct sigsafe_jmp_ *sigsafe_lookup_jmp_(void *ip);
+
+/**
+ * Binary search of <tt>n</tt> non-overlapping regions, sorted by address.
+ * Exposed for the benchmarks.
+ */
+HIDDEN_DEC const struct sigsafe_jmp_ *
+sigsafe_search_jmp_(const struct sigsafe_jmp_ *jmps, size_t n, void *ip);
+
+/**
+ * Adds a module's <tt>sigsafe_jmptab</tt> section, an array of
+ * <tt>struct sigsafe_jmp_</tt>, to those searched by sigsafe_lookup_jmp_().
+ * Called from a constructor in each file including sigsafe_inline.h;
+ * repeated calls for the same module are ignored. Sorts the section in place.
+ */
+void sigsafe_register_jmptab_(void *start, void *stop);
+
 #ifdef SIGSAFE_NO_SIGINFO
 HIDDEN_DEC void sigsafe_handler_for_platform_(struct sigcontext *ctx);
 #else
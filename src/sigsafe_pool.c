@@ -0,0 +1,550 @@
+/** @file
+ * A work-stealing thread pool whose tasks can be cancelled by interrupting
+ * the one worker running them. Each worker owns a Chase-Lev deque: it pushes
+ * and takes at the bottom without locks, and idle workers steal from the
+ * top. Tasks from outside the pool go through one locked queue. A task's
+ * state word decides every race between it starting, finishing, and being
+ * cancelled, so the interrupt signal is only ever sent to the worker running
+ * that task, and is taken before the worker moves on.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include "sigsafe_internal.h"
+#include <errno.h>
+
+#ifdef SIGSAFE_HAVE_INTERRUPT
+#ifdef _THREAD_SAFE
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define TASK_QUEUED         0
+#define TASK_RUNNING        1
+#define TASK_INTERRUPTING   2   /* cancelled while running; signal going */
+#define TASK_INTERRUPTED    3   /* ...and sent */
+#define TASK_CANCELLING     4   /* cancelled while queued; not yet dropped */
+#define TASK_DONE           5   /* final: ran to completion */
+#define TASK_CANCELLED      6   /* final */
+#define TASK_WAITERS        0x100 /* or'd in while someone waits */
+
+#define DEQUE_SIZE 1024 /* a power of two; overflow goes to the shared queue */
+
+struct worker {
+    /* The thieves' end and the owner's end, on separate cache lines. */
+    volatile long top __attribute__ ((aligned (64)));
+    volatile long bottom __attribute__ ((aligned (64)));
+    struct sigsafe_task *slots[DEQUE_SIZE];
+    struct sigsafe_pool *pool;
+    pthread_t thread;
+    int status;                       /* under pool lock: 0 until started */
+    struct sigsafe_task *current;
+    unsigned int next_victim;
+} __attribute__ ((aligned (64)));
+
+struct sigsafe_pool {
+    struct worker *workers;
+    int nworkers;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t started;           /* a worker has set its status */
+    struct sigsafe_task *head, *tail; /* the shared queue, under lock */
+    volatile long queued;             /* tasks in any queue */
+    volatile int sleepers;
+    int stopping;                     /* under lock */
+};
+
+static pthread_key_t worker_key;
+static pthread_once_t worker_key_once = PTHREAD_ONCE_INIT;
+static volatile int worker_key_created;
+
+static void
+create_worker_key(void)
+{
+    if (pthread_key_create(&worker_key, NULL) == 0) {
+        worker_key_created = 1;
+    }
+}
+
+/** Returns the calling thread's worker, or NULL if it isn't one. */
+static struct worker *
+self(void)
+{
+    return worker_key_created
+           ? (struct worker*) pthread_getspecific(worker_key) : NULL;
+}
+
+/* The deque, after Le, Pop, Cohen, and Zappa Nardelli, PPoPP 2013. */
+
+/** Pushes at the bottom; owner only. @return 0, or -1 if full. */
+static int
+deque_push(struct worker *w, struct sigsafe_task *task)
+{
+    long b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED);
+    long t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+
+    if (b - t >= DEQUE_SIZE) {
+        return -1;
+    }
+    __atomic_store_n(&w->slots[b & (DEQUE_SIZE - 1)], task, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/** Takes the newest task from the bottom; owner only. */
+static struct sigsafe_task *
+deque_take(struct worker *w)
+{
+    long b = __atomic_load_n(&w->bottom, __ATOMIC_RELAXED) - 1;
+    long t;
+    struct sigsafe_task *task = NULL;
+
+    __atomic_store_n(&w->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    t = __atomic_load_n(&w->top, __ATOMIC_RELAXED);
+    if (t <= b) {
+        task = __atomic_load_n(&w->slots[b & (DEQUE_SIZE - 1)],
+                               __ATOMIC_RELAXED);
+        if (t == b) {
+            /* The last one; race the thieves for it. */
+            if (!__atomic_compare_exchange_n(&w->top, &t, t + 1, 0,
+                                             __ATOMIC_SEQ_CST,
+                                             __ATOMIC_RELAXED)) {
+                task = NULL;
+            }
+            __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&w->bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+/** Steals the oldest task from the top; any thread. */
+static struct sigsafe_task *
+deque_steal(struct worker *w)
+{
+    long t = __atomic_load_n(&w->top, __ATOMIC_ACQUIRE);
+    long b;
+    struct sigsafe_task *task;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    b = __atomic_load_n(&w->bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) {
+        return NULL;
+    }
+    task = __atomic_load_n(&w->slots[t & (DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&w->top, &t, t + 1, 0, __ATOMIC_SEQ_CST,
+                                     __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return task;
+}
+
+/*
+ * A waiter may return and reuse the task as soon as it sees a final state,
+ * so whoever publishes one learns from that same atomic operation whether
+ * to wake anyone, and doesn't touch the task afterward. (FUTEX_WAKE only
+ * uses the address.)
+ */
+
+static void
+wake(struct sigsafe_task *task, int old)
+{
+    if (old & TASK_WAITERS) {
+        syscall(SYS_futex, &task->state, FUTEX_WAKE_PRIVATE, 0x7fffffff,
+                NULL, NULL, 0);
+    }
+}
+
+/**
+ * Moves a task from one state to another, keeping the waiter bit.
+ * @return non-zero on success; zero if it wasn't in <tt>from</tt>.
+ */
+static int
+transition(struct sigsafe_task *task, int from, int to)
+{
+    int state = __atomic_load_n(&task->state, __ATOMIC_ACQUIRE);
+
+    while ((state & ~TASK_WAITERS) == from) {
+        if (__atomic_compare_exchange_n(&task->state, &state,
+                                        to | (state & TASK_WAITERS), 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** Publishes a final state, from whatever the task was in. */
+static void
+finish(struct sigsafe_task *task, int state)
+{
+    wake(task, __atomic_exchange_n(&task->state, state, __ATOMIC_ACQ_REL));
+}
+
+/**
+ * Publishes a final state if the task is in <tt>from</tt>.
+ * @return non-zero on success.
+ */
+static int
+finish_from(struct sigsafe_task *task, int from, int final)
+{
+    int state = __atomic_load_n(&task->state, __ATOMIC_ACQUIRE);
+
+    while ((state & ~TASK_WAITERS) == from) {
+        if (__atomic_compare_exchange_n(&task->state, &state, final, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            wake(task, state);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void
+run_task(struct worker *w, struct sigsafe_task *task)
+{
+    sigset_t pending;
+    int state;
+
+    /* Published by the state change, for sigsafe_pool_cancel. */
+    task->worker = sigsafe_thread_self();
+    if (!transition(task, TASK_QUEUED, TASK_RUNNING)) {
+        finish(task, TASK_CANCELLED); /* cancelled while queued */
+        return;
+    }
+
+    w->current = task;
+    sigsafe_clear_received();
+    task->fn(task->arg);
+    w->current = NULL;
+
+    if (finish_from(task, TASK_RUNNING, TASK_DONE)) {
+        return;
+    }
+
+    /*
+     * It was cancelled. Wait for the canceller's tgkill to have happened;
+     * the signal is then pending here if not yet delivered, and is
+     * delivered on the way out of any system call. Then the next task
+     * starts with a clean flag. If the tgkill failed, the canceller puts
+     * the task back to running, and it finishes normally.
+     */
+    while ((state = __atomic_load_n(&task->state, __ATOMIC_ACQUIRE)
+                    & ~TASK_WAITERS) != TASK_INTERRUPTED) {
+        if (state == TASK_RUNNING
+            && finish_from(task, TASK_RUNNING, TASK_DONE)) {
+            return;
+        }
+        sched_yield();
+    }
+
+    /*
+     * The loop above may not have entered the kernel since the tgkill. Make
+     * one cheap system call so a still-pending signal is delivered now,
+     * before the flag is cleared rather than during the next task.
+     */
+    sigpending(&pending);
+    sigsafe_clear_received();
+    finish(task, TASK_CANCELLED);
+}
+
+/** Finds a task: from this worker's deque, the shared queue, or a victim. */
+static struct sigsafe_task *
+find_task(struct worker *w)
+{
+    struct sigsafe_pool *pool = w->pool;
+    struct sigsafe_task *task;
+    int i;
+
+    task = deque_take(w);
+    if (task != NULL) {
+        return task;
+    }
+    if (__atomic_load_n(&pool->head, __ATOMIC_ACQUIRE) != NULL) {
+        pthread_mutex_lock(&pool->lock);
+        task = pool->head;
+        if (task != NULL) {
+            pool->head = task->next;
+            if (pool->head == NULL) {
+                pool->tail = NULL;
+            }
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if (task != NULL) {
+            return task;
+        }
+    }
+    for (i = 0; i < pool->nworkers; i++) {
+        struct worker *victim;
+
+        victim = &pool->workers[w->next_victim++ % pool->nworkers];
+        if (victim != w) {
+            task = deque_steal(victim);
+            if (task != NULL) {
+                return task;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void*
+worker_main(void *arg)
+{
+    struct worker *w = (struct worker*) arg;
+    struct sigsafe_pool *pool = w->pool;
+    struct sigsafe_task *task;
+    int retval;
+
+    retval = sigsafe_install_tsd(0, NULL);
+    pthread_mutex_lock(&pool->lock);
+    w->status = (retval != 0) ? retval : 1;
+    pthread_cond_signal(&pool->started);
+    pthread_mutex_unlock(&pool->lock);
+    if (retval != 0) {
+        return NULL;
+    }
+    pthread_setspecific(worker_key, w);
+    for (;;) {
+        task = find_task(w);
+        if (task != NULL) {
+            __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+            run_task(w, task);
+            continue;
+        }
+        if (__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) > 0) {
+            continue; /* a push or steal in flight; look again */
+        }
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        while (!pool->stopping
+               && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        if (pool->stopping
+            && __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+int
+sigsafe_pool_create(struct sigsafe_pool **poolp, int workers)
+{
+    struct sigsafe_pool *pool;
+    int i, retval;
+
+    if (workers < 1 || sigsafe_interrupt_signum_ == 0) {
+        return -EINVAL;
+    }
+    pthread_once(&worker_key_once, create_worker_key);
+    if (!worker_key_created) {
+        return -EAGAIN;
+    }
+    pool = (struct sigsafe_pool*) malloc(sizeof(*pool));
+    if (pool == NULL) {
+        return -ENOMEM;
+    }
+    memset(pool, 0, sizeof(*pool));
+    if (posix_memalign((void**) &pool->workers, 64,
+                       workers * sizeof(struct worker)) != 0) {
+        free(pool);
+        return -ENOMEM;
+    }
+    memset(pool->workers, 0, workers * sizeof(struct worker));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->started, NULL);
+    for (i = 0; i < workers; i++) {
+        struct worker *w = &pool->workers[i];
+
+        w->pool = pool;
+        w->next_victim = i + 1;
+        retval = pthread_create(&w->thread, NULL, worker_main, w);
+        if (retval != 0) {
+            pool->nworkers = i;
+            sigsafe_pool_destroy(pool);
+            return -retval;
+        }
+        pool->nworkers = i + 1;
+    }
+
+    /* Fail if any worker couldn't get its TSD. */
+    retval = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (i = 0; i < workers; i++) {
+        while (pool->workers[i].status == 0) {
+            pthread_cond_wait(&pool->started, &pool->lock);
+        }
+        if (pool->workers[i].status < 0 && retval == 0) {
+            retval = pool->workers[i].status;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (retval != 0) {
+        sigsafe_pool_destroy(pool);
+        return retval;
+    }
+    *poolp = pool;
+    return 0;
+}
+
+void
+sigsafe_pool_destroy(struct sigsafe_pool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->nworkers; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&pool->started);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+}
+
+int
+sigsafe_pool_submit(struct sigsafe_pool *pool, struct sigsafe_task *task,
+                    sigsafe_pool_fn_t fn, void *arg)
+{
+    struct worker *w = self();
+
+    task->fn = fn;
+    task->arg = arg;
+    task->state = TASK_QUEUED;
+    task->worker = NULL;
+    task->next = NULL;
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+
+    if (w == NULL || w->pool != pool || deque_push(w, task) != 0) {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->tail != NULL) {
+            pool->tail->next = task;
+        } else {
+            pool->head = task;
+        }
+        pool->tail = task;
+        if (pool->sleepers > 0) {
+            pthread_cond_signal(&pool->wake);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    } else if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        /* Someone is idle; let them steal it. */
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return 0;
+}
+
+int
+sigsafe_pool_cancel(struct sigsafe_task *task)
+{
+    int retval;
+
+    if (transition(task, TASK_QUEUED, TASK_CANCELLING)) {
+        return 0; /* whoever dequeues it drops it */
+    }
+    if (transition(task, TASK_RUNNING, TASK_INTERRUPTING)) {
+        retval = sigsafe_interrupt_thread(task->worker);
+        transition(task, TASK_INTERRUPTING,
+                   retval == 0 ? TASK_INTERRUPTED : TASK_RUNNING);
+        return retval;
+    }
+    return -ESRCH;
+}
+
+int
+sigsafe_pool_wait(struct sigsafe_task *task)
+{
+    int state;
+
+    state = __atomic_load_n(&task->state, __ATOMIC_ACQUIRE);
+    for (;;) {
+        if (state == TASK_DONE) {
+            return 0;
+        } else if (state == TASK_CANCELLED) {
+            return -ECANCELED;
+        }
+        if (!(state & TASK_WAITERS)
+            && !__atomic_compare_exchange_n(&task->state, &state,
+                                            state | TASK_WAITERS, 0,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE)) {
+            continue; /* state changed; look again */
+        }
+        syscall(SYS_futex, &task->state, FUTEX_WAIT_PRIVATE,
+                state | TASK_WAITERS, NULL, NULL, 0);
+        state = __atomic_load_n(&task->state, __ATOMIC_ACQUIRE);
+    }
+}
+
+int
+sigsafe_pool_cancelled(void)
+{
+    struct worker *w = self();
+    int state;
+
+    if (w == NULL || w->current == NULL) {
+        return 0;
+    }
+    state = __atomic_load_n(&w->current->state, __ATOMIC_ACQUIRE)
+            & ~TASK_WAITERS;
+    return state == TASK_INTERRUPTING || state == TASK_INTERRUPTED;
+}
+#else /* !_THREAD_SAFE */
+int
+sigsafe_pool_create(struct sigsafe_pool **pool, int workers)
+{
+    return -ENOSYS;
+}
+
+void
+sigsafe_pool_destroy(struct sigsafe_pool *pool)
+{
+}
+
+int
+sigsafe_pool_submit(struct sigsafe_pool *pool, struct sigsafe_task *task,
+                    sigsafe_pool_fn_t fn, void *arg)
+{
+    return -ENOSYS;
+}
+
+int
+sigsafe_pool_cancel(struct sigsafe_task *task)
+{
+    return -ESRCH;
+}
+
+int
+sigsafe_pool_wait(struct sigsafe_task *task)
+{
+    return -ENOSYS;
+}
+
+int
+sigsafe_pool_cancelled(void)
+{
+    return 0;
+}
+#endif /* _THREAD_SAFE */
+#endif /* SIGSAFE_HAVE_INTERRUPT */
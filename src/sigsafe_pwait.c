@@ -0,0 +1,118 @@
+/** @file
+ * Signal-safe waits with nanosecond timeouts on Linux.
+ * The kernel's ppoll, pselect6, and epoll_pwait2 all take a signal mask to
+ * close the race between checking a flag and blocking. sigsafe closes that
+ * race itself, so these always pass a NULL mask.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include "sigsafe_internal.h"
+#include <errno.h>
+#include <limits.h>
+
+#ifdef SIGSAFE_HAVE_PPOLL
+INTERNAL_DEC int sigsafe_raw_ppoll(struct pollfd *fds, unsigned int nfds,
+                                   struct timespec *tsp,
+                                   const sigset_t *sigmask, size_t sigsetsize);
+
+int
+sigsafe_ppoll(struct pollfd *fds, unsigned int nfds,
+              const struct timespec *timeout)
+{
+    struct timespec ts;
+
+    /* The kernel writes the time remaining back; don't clobber the caller's. */
+    if (timeout == NULL) {
+        return sigsafe_raw_ppoll(fds, nfds, NULL, NULL, 0);
+    }
+    ts = *timeout;
+    return sigsafe_raw_ppoll(fds, nfds, &ts, NULL, 0);
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_PSELECT
+INTERNAL_DEC int sigsafe_raw_pselect6(int nfds, fd_set *readfds,
+                                      fd_set *writefds, fd_set *exceptfds,
+                                      struct timespec *tsp, void *sig);
+
+int
+sigsafe_pselect(int nfds, fd_set *readfds, fd_set *writefds,
+                fd_set *exceptfds, const struct timespec *timeout)
+{
+    struct timespec ts;
+
+    if (timeout == NULL) {
+        return sigsafe_raw_pselect6(nfds, readfds, writefds, exceptfds, NULL,
+                                    NULL);
+    }
+    ts = *timeout;
+    return sigsafe_raw_pselect6(nfds, readfds, writefds, exceptfds, &ts,
+                                NULL);
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_EPOLL_PWAIT2
+/** The kernel's <tt>struct __kernel_timespec</tt>, 64-bit even on i386. */
+struct kernel_timespec64 {
+    long long tv_sec;
+    long long tv_nsec;
+};
+
+INTERNAL_DEC int sigsafe_raw_epoll_pwait2(int epfd,
+                                          struct epoll_event *events,
+                                          int maxevents,
+                                          const struct kernel_timespec64 *tsp,
+                                          const sigset_t *sigmask,
+                                          size_t sigsetsize);
+
+/** Set once the kernel says it has no epoll_pwait2. */
+static volatile sig_atomic_t no_epoll_pwait2;
+
+/** Rounds a timespec up to whole milliseconds, as epoll_wait wants. */
+static int
+timespec_to_ms(const struct timespec *ts)
+{
+    long long ms;
+
+    if (ts == NULL) {
+        return -1;
+    }
+    if (ts->tv_sec >= INT_MAX / 1000) {
+        return INT_MAX; /* saturate at about 24 days */
+    }
+    ms = (long long) ts->tv_sec * 1000 + (ts->tv_nsec + 999999) / 1000000;
+    return (ms > INT_MAX) ? INT_MAX : (int) ms;
+}
+
+int
+sigsafe_epoll_pwait2(int epfd, struct epoll_event *events, int maxevents,
+                     const struct timespec *timeout)
+{
+    struct kernel_timespec64 kts;
+    int retval;
+
+    if (timeout != NULL && (timeout->tv_sec < 0 || timeout->tv_nsec < 0
+                            || timeout->tv_nsec >= 1000000000)) {
+        return -EINVAL;
+    }
+    if (!no_epoll_pwait2) {
+        if (timeout != NULL) {
+            kts.tv_sec = timeout->tv_sec;
+            kts.tv_nsec = timeout->tv_nsec;
+        }
+        retval = sigsafe_raw_epoll_pwait2(epfd, events, maxevents,
+                                          (timeout != NULL) ? &kts : NULL,
+                                          NULL, 0);
+        if (retval != -ENOSYS) {
+            return retval;
+        }
+        no_epoll_pwait2 = 1;
+    }
+    return sigsafe_epoll_wait(epfd, events, maxevents,
+                              timespec_to_ms(timeout));
+}
+#endif
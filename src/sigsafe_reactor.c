@@ -0,0 +1,592 @@
+/** @file
+ * A small event loop on the sigsafe waits. Signals need no self-pipe: the
+ * wait itself returns <tt>-EINTR</tt>, and the reactor hands the signals its
+ * thread recorded to callbacks. Descriptors are watched with epoll where
+ * available, else poll, else select; timers live in a binary heap.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include <sigsafe.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#if !defined(NSIG) && defined(_NSIG)
+#define NSIG _NSIG
+#endif
+
+#if defined(SIGSAFE_HAVE_EPOLL)
+#define REACTOR_EPOLL
+#define MAX_EVENTS 64
+#elif defined(SIGSAFE_HAVE_POLL)
+#define REACTOR_POLL
+#else
+#define REACTOR_SELECT
+#endif
+
+/*
+ * On Linux this is answered from the vDSO, so reading it every iteration
+ * costs no system call.
+ */
+static long long
+now_ns(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000000 + now.tv_nsec;
+#else
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (long long) now.tv_sec * 1000000000 + now.tv_usec * 1000;
+#endif
+}
+
+/**
+ * Converts readiness to the SIGSAFE_REACTOR_* events a registration asked
+ * for. A hangup or error wakes whichever side is waiting.
+ */
+static int
+ready_events(int wanted, int readable, int writable, int error)
+{
+    int ready = (readable ? SIGSAFE_REACTOR_READ  : 0)
+              | (writable ? SIGSAFE_REACTOR_WRITE : 0);
+
+    if (error) {
+        ready |= wanted;
+    }
+    return ready & wanted;
+}
+
+#ifdef REACTOR_EPOLL
+static unsigned int
+epoll_events(int events)
+{
+    return ((events & SIGSAFE_REACTOR_READ)  ? EPOLLIN  : 0)
+         | ((events & SIGSAFE_REACTOR_WRITE) ? EPOLLOUT : 0);
+}
+#endif
+
+#ifdef REACTOR_POLL
+static short
+poll_events(int events)
+{
+    return ((events & SIGSAFE_REACTOR_READ)  ? POLLIN  : 0)
+         | ((events & SIGSAFE_REACTOR_WRITE) ? POLLOUT : 0);
+}
+#endif
+
+int
+sigsafe_reactor_init(struct sigsafe_reactor *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->epfd = -1;
+#ifdef REACTOR_EPOLL
+    r->epfd = epoll_create(MAX_EVENTS);
+    if (r->epfd < 0) {
+        return -errno;
+    }
+    r->events = malloc(MAX_EVENTS * sizeof(struct epoll_event));
+    if (r->events == NULL) {
+        close(r->epfd);
+        return -ENOMEM;
+    }
+#endif
+    r->now_ns = now_ns();
+    return 0;
+}
+
+void
+sigsafe_reactor_destroy(struct sigsafe_reactor *r)
+{
+    if (r->epfd != -1) {
+        close(r->epfd);
+    }
+    free(r->events);
+    free(r->fds);
+    free(r->pfds);
+    free(r->ready);
+    free(r->heap);
+    memset(r, 0, sizeof(*r));
+    r->epfd = -1;
+}
+
+#ifndef REACTOR_EPOLL
+/** Makes room for one more registration in the poll/select arrays. */
+static int
+grow_fds(struct sigsafe_reactor *r)
+{
+    int cap = (r->fds_cap == 0) ? 16 : 2 * r->fds_cap;
+    void *p;
+
+    if (r->nfds < r->fds_cap) {
+        return 0;
+    }
+    p = realloc(r->fds, cap * sizeof(*r->fds));
+    if (p == NULL) {
+        return -ENOMEM;
+    }
+    r->fds = (struct sigsafe_reactor_fd**) p;
+    p = realloc(r->ready, cap * sizeof(*r->ready));
+    if (p == NULL) {
+        return -ENOMEM;
+    }
+    r->ready = (struct sigsafe_reactor_fd**) p;
+#ifdef REACTOR_POLL
+    p = realloc(r->pfds, cap * sizeof(struct pollfd));
+    if (p == NULL) {
+        return -ENOMEM;
+    }
+    r->pfds = p;
+#endif
+    r->fds_cap = cap;
+    return 0;
+}
+#endif
+
+int
+sigsafe_reactor_add_fd(struct sigsafe_reactor *r,
+                       struct sigsafe_reactor_fd *h, int fd, int events,
+                       sigsafe_reactor_io_handler_t handler, void *arg)
+{
+#ifdef REACTOR_EPOLL
+    struct epoll_event ev;
+#else
+    int retval;
+#endif
+
+    h->fd = fd;
+    h->events = events;
+    h->handler = handler;
+    h->arg = arg;
+    h->revents = 0;
+#ifdef REACTOR_EPOLL
+    memset(&ev, 0, sizeof(ev));
+    ev.events = epoll_events(events);
+    ev.data.ptr = h;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        return -errno;
+    }
+    h->index = -1;
+#else
+#ifdef REACTOR_SELECT
+    if (fd < 0 || fd >= FD_SETSIZE) {
+        return -EINVAL;
+    }
+#endif
+    retval = grow_fds(r);
+    if (retval != 0) {
+        return retval;
+    }
+    h->index = r->nfds;
+    r->fds[r->nfds] = h;
+#ifdef REACTOR_POLL
+    ((struct pollfd*) r->pfds)[r->nfds].fd = fd;
+    ((struct pollfd*) r->pfds)[r->nfds].events = poll_events(events);
+    ((struct pollfd*) r->pfds)[r->nfds].revents = 0;
+#endif
+    r->nfds++;
+#endif
+    return 0;
+}
+
+int
+sigsafe_reactor_modify_fd(struct sigsafe_reactor *r,
+                          struct sigsafe_reactor_fd *h, int events)
+{
+#ifdef REACTOR_EPOLL
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = epoll_events(events);
+    ev.data.ptr = h;
+    if (epoll_ctl(r->epfd, EPOLL_CTL_MOD, h->fd, &ev) != 0) {
+        return -errno;
+    }
+#elif defined(REACTOR_POLL)
+    ((struct pollfd*) r->pfds)[h->index].events = poll_events(events);
+#endif
+    h->events = events;
+    return 0;
+}
+
+void
+sigsafe_reactor_remove_fd(struct sigsafe_reactor *r,
+                          struct sigsafe_reactor_fd *h)
+{
+    int i;
+
+#ifdef REACTOR_EPOLL
+    struct epoll_event *events = (struct epoll_event*) r->events;
+    struct epoll_event ev; /* pre-2.6.9 kernels want one, even for DEL */
+
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl(r->epfd, EPOLL_CTL_DEL, h->fd, &ev);
+    for (i = r->next_ready; i < r->nready; i++) {
+        if (events[i].data.ptr == h) {
+            events[i].data.ptr = NULL;
+        }
+    }
+#else
+    struct sigsafe_reactor_fd *last = r->fds[--r->nfds];
+
+    /* Move the last registration into the hole. */
+    r->fds[h->index] = last;
+#ifdef REACTOR_POLL
+    ((struct pollfd*) r->pfds)[h->index] =
+            ((struct pollfd*) r->pfds)[r->nfds];
+#endif
+    last->index = h->index;
+    for (i = r->next_ready; i < r->nready; i++) {
+        if (r->ready[i] == h) {
+            r->ready[i] = NULL;
+        }
+    }
+#endif
+    h->index = -1;
+}
+
+/* The timer heap: heap[0] is the soonest, and each knows its own index. */
+
+static void
+heap_set(struct sigsafe_reactor *r, int i, struct sigsafe_reactor_timer *t)
+{
+    r->heap[i] = t;
+    t->heap_index = i;
+}
+
+static void
+heap_up(struct sigsafe_reactor *r, int i)
+{
+    struct sigsafe_reactor_timer *t = r->heap[i];
+
+    while (i > 0 && r->heap[(i - 1) / 2]->deadline_ns > t->deadline_ns) {
+        heap_set(r, i, r->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    heap_set(r, i, t);
+}
+
+static void
+heap_down(struct sigsafe_reactor *r, int i)
+{
+    struct sigsafe_reactor_timer *t = r->heap[i];
+
+    for (;;) {
+        int child = 2 * i + 1;
+
+        if (child >= r->nheap) {
+            break;
+        }
+        if (child + 1 < r->nheap
+            && r->heap[child + 1]->deadline_ns < r->heap[child]->deadline_ns) {
+            child++;
+        }
+        if (r->heap[child]->deadline_ns >= t->deadline_ns) {
+            break;
+        }
+        heap_set(r, i, r->heap[child]);
+        i = child;
+    }
+    heap_set(r, i, t);
+}
+
+static void
+heap_remove(struct sigsafe_reactor *r, struct sigsafe_reactor_timer *t)
+{
+    struct sigsafe_reactor_timer *moved;
+    int i = t->heap_index;
+
+    t->heap_index = -1;
+    if (--r->nheap == i) {
+        return;
+    }
+    moved = r->heap[r->nheap];
+    heap_set(r, i, moved);
+    heap_up(r, i);
+    heap_down(r, moved->heap_index);
+}
+
+int
+sigsafe_reactor_add_timer(struct sigsafe_reactor *r,
+                          struct sigsafe_reactor_timer *t,
+                          const struct timespec *delay,
+                          sigsafe_reactor_timer_handler_t handler, void *arg)
+{
+    if (r->nheap == r->heap_cap) {
+        int cap = (r->heap_cap == 0) ? 16 : 2 * r->heap_cap;
+        void *p = realloc(r->heap, cap * sizeof(*r->heap));
+
+        if (p == NULL) {
+            return -ENOMEM;
+        }
+        r->heap = (struct sigsafe_reactor_timer**) p;
+        r->heap_cap = cap;
+    }
+    t->deadline_ns = r->now_ns + (long long) delay->tv_sec * 1000000000
+                   + delay->tv_nsec;
+    t->handler = handler;
+    t->arg = arg;
+    t->due = 0;
+    r->heap[r->nheap] = t;
+    heap_up(r, r->nheap++);
+    return 0;
+}
+
+void
+sigsafe_reactor_cancel_timer(struct sigsafe_reactor *r,
+                             struct sigsafe_reactor_timer *t)
+{
+    if (t->heap_index >= 0 && t->heap_index < r->nheap
+        && r->heap[t->heap_index] == t) {
+        heap_remove(r, t);
+    }
+    t->due = 0;
+}
+
+void
+sigsafe_reactor_add_signal(struct sigsafe_reactor *r,
+                           struct sigsafe_reactor_signal *s, int signum,
+                           sigsafe_reactor_signal_handler_t handler, void *arg)
+{
+    s->signum = signum;
+    s->handler = handler;
+    s->arg = arg;
+    s->next = r->signals;
+    r->signals = s;
+}
+
+void
+sigsafe_reactor_remove_signal(struct sigsafe_reactor *r,
+                              struct sigsafe_reactor_signal *s)
+{
+    struct sigsafe_reactor_signal **p;
+
+    for (p = &r->signals; *p != NULL; p = &(*p)->next) {
+        if (*p == s) {
+            *p = s->next;
+            break;
+        }
+    }
+}
+
+/**
+ * Runs the deferred handlers and callbacks of signals recorded since the
+ * last pass. Signals with neither stay pending for the application, but the
+ * flag is cleared so the next wait blocks.
+ */
+static int
+run_signals(struct sigsafe_reactor *r)
+{
+    unsigned int counts[NSIG];
+    struct sigsafe_reactor_signal *s, *next;
+    sigset_t which, received;
+    int ran;
+
+    if (!sigsafe_signal_pending()) {
+        return 0;
+    }
+    ran = sigsafe_dispatch_pending();
+    sigemptyset(&which);
+    for (s = r->signals; s != NULL; s = s->next) {
+        sigaddset(&which, s->signum);
+    }
+    sigsafe_fetch_received_in(&which, &received, counts, NSIG);
+    for (s = r->signals; s != NULL; s = next) {
+        next = s->next;
+        if (sigismember(&received, s->signum)) {
+            s->handler(s->signum, counts[s->signum], s->arg);
+            ran++;
+        }
+    }
+    return ran;
+}
+
+/**
+ * Runs the timers which had expired as of the last wait. They're taken off
+ * the heap before any runs, so one re-armed with no delay waits a pass.
+ */
+static int
+run_timers(struct sigsafe_reactor *r)
+{
+    struct sigsafe_reactor_timer *due = NULL, **tail = &due, *t;
+    int ran = 0;
+
+    while (r->nheap > 0 && r->heap[0]->deadline_ns <= r->now_ns) {
+        t = r->heap[0];
+        heap_remove(r, t);
+        t->due = 1;
+        t->next_due = NULL;
+        *tail = t;
+        tail = &t->next_due;
+    }
+    while (due != NULL) {
+        t = due;
+        due = t->next_due;
+        if (t->due) { /* not cancelled by an earlier callback */
+            t->due = 0;
+            t->handler(t->arg);
+            ran++;
+        }
+    }
+    return ran;
+}
+
+/** Milliseconds until the soonest timer, rounded up; -1 for none. */
+static int
+timeout_ms(struct sigsafe_reactor *r, int block)
+{
+    long long left;
+
+    if (!block) {
+        return 0;
+    }
+    if (r->nheap == 0) {
+        return -1;
+    }
+    left = r->heap[0]->deadline_ns - now_ns();
+    if (left <= 0) {
+        return 0;
+    }
+    left = (left + 999999) / 1000000;
+    return (left > INT_MAX) ? INT_MAX : (int) left;
+}
+
+int
+sigsafe_reactor_run_once(struct sigsafe_reactor *r, int block)
+{
+    int timeout = timeout_ms(r, block);
+    int n, ran;
+#ifndef REACTOR_EPOLL
+    int i;
+#endif
+#ifdef REACTOR_EPOLL
+    struct epoll_event *events = (struct epoll_event*) r->events;
+
+    n = sigsafe_epoll_wait(r->epfd, events, MAX_EVENTS, timeout);
+#elif defined(REACTOR_POLL)
+    struct pollfd *pfds = (struct pollfd*) r->pfds;
+
+    n = sigsafe_poll(pfds, r->nfds, timeout);
+#else
+    fd_set readfds, writefds;
+    struct timeval tv;
+    int maxfd = -1;
+
+    FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
+    for (i = 0; i < r->nfds; i++) {
+        struct sigsafe_reactor_fd *h = r->fds[i];
+
+        if (h->events & SIGSAFE_REACTOR_READ) {
+            FD_SET(h->fd, &readfds);
+        }
+        if (h->events & SIGSAFE_REACTOR_WRITE) {
+            FD_SET(h->fd, &writefds);
+        }
+        if (h->fd > maxfd) {
+            maxfd = h->fd;
+        }
+    }
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    n = sigsafe_select(maxfd + 1, &readfds, &writefds, NULL,
+                       (timeout < 0) ? NULL : &tv);
+#endif
+    if (n == -EINTR) {
+        n = 0;
+    } else if (n < 0) {
+        return n;
+    }
+    r->now_ns = now_ns();
+
+    r->nready = r->next_ready = 0;
+#ifdef REACTOR_EPOLL
+    r->nready = n;
+#elif defined(REACTOR_POLL)
+    for (i = 0; i < r->nfds && r->nready < n; i++) {
+        if (pfds[i].revents != 0) {
+            struct sigsafe_reactor_fd *h = r->fds[i];
+
+            h->revents = ready_events(h->events, pfds[i].revents & POLLIN,
+                                      pfds[i].revents & POLLOUT,
+                                      pfds[i].revents
+                                      & (POLLERR | POLLHUP | POLLNVAL));
+            r->ready[r->nready++] = h;
+        }
+    }
+#else
+    for (i = 0; i < r->nfds && n > 0; i++) {
+        struct sigsafe_reactor_fd *h = r->fds[i];
+        int readable = FD_ISSET(h->fd, &readfds);
+        int writable = FD_ISSET(h->fd, &writefds);
+
+        if (readable || writable) {
+            h->revents = ready_events(h->events, readable, writable, 0);
+            r->ready[r->nready++] = h;
+        }
+    }
+#endif
+
+    ran = run_signals(r);
+    ran += run_timers(r);
+    while (r->next_ready < r->nready) {
+#ifdef REACTOR_EPOLL
+        struct epoll_event *ev = &events[r->next_ready++];
+        struct sigsafe_reactor_fd *h;
+        int ready;
+
+        h = (struct sigsafe_reactor_fd*) ev->data.ptr;
+        if (h == NULL) {
+            continue;
+        }
+        ready = ready_events(h->events, ev->events & EPOLLIN,
+                             ev->events & EPOLLOUT,
+                             ev->events & (EPOLLERR | EPOLLHUP));
+#else
+        struct sigsafe_reactor_fd *h = r->ready[r->next_ready++];
+        int ready;
+
+        if (h == NULL) {
+            continue;
+        }
+        ready = h->revents;
+#endif
+        if (ready != 0) {
+            h->handler(h->fd, ready, h->arg);
+            ran++;
+        }
+    }
+    r->nready = r->next_ready = 0;
+    return ran;
+}
+
+int
+sigsafe_reactor_run(struct sigsafe_reactor *r)
+{
+    int retval;
+
+    while (!r->stopping) {
+        retval = sigsafe_reactor_run_once(r, 1);
+        if (retval < 0) {
+            return retval;
+        }
+    }
+    r->stopping = 0;
+    return 0;
+}
+
+void
+sigsafe_reactor_stop(struct sigsafe_reactor *r)
+{
+    r->stopping = 1;
+}
@@ -0,0 +1,199 @@
+/** @file
+ * Minimal io_uring ring management on top of sigsafe_io_uring_enter().
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include "sigsafe_internal.h"
+
+#ifdef SIGSAFE_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * The kernel reads sq_tail and cq_head and writes sq_head and cq_tail
+ * concurrently, so those need acquire/release ordering.
+ */
+#define LOAD_ACQUIRE(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+int
+sigsafe_uring_init(struct sigsafe_uring *ring, unsigned int entries)
+{
+    struct io_uring_params p;
+    char *sq, *cq;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    ring->fd = syscall(SYS_io_uring_setup, entries, &p);
+    if (ring->fd < 0) {
+        return -errno;
+    }
+
+    ring->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    ring->cq_map_size = p.cq_off.cqes
+                      + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = 0;
+    }
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        goto fail;
+    }
+    if (ring->cq_map_size == 0) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) {
+            goto fail;
+        }
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        goto fail;
+    }
+
+    sq = (char*) ring->sq_map;
+    ring->sq_head    = (unsigned int*) (sq + p.sq_off.head);
+    ring->sq_tail    = (unsigned int*) (sq + p.sq_off.tail);
+    ring->sq_array   = (unsigned int*) (sq + p.sq_off.array);
+    ring->sq_mask    = *(unsigned int*) (sq + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->sqe_tail   = *ring->sq_tail;
+    cq = (char*) ring->cq_map;
+    ring->cq_head    = (unsigned int*) (cq + p.cq_off.head);
+    ring->cq_tail    = (unsigned int*) (cq + p.cq_off.tail);
+    ring->cq_mask    = *(unsigned int*) (cq + p.cq_off.ring_mask);
+    ring->cqes       = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    {
+        int retval = -errno;
+        if (ring->sqes == MAP_FAILED) {
+            ring->sqes = NULL;
+        }
+        if (ring->cq_map == MAP_FAILED) {
+            ring->cq_map = NULL;
+        }
+        if (ring->sq_map == MAP_FAILED) {
+            ring->sq_map = NULL;
+        }
+        sigsafe_uring_destroy(ring);
+        return retval;
+    }
+}
+
+void
+sigsafe_uring_destroy(struct sigsafe_uring *ring)
+{
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_map != NULL && ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    if (ring->sq_map != NULL) {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+struct io_uring_sqe *
+sigsafe_uring_get_sqe(struct sigsafe_uring *ring)
+{
+    struct io_uring_sqe *sqe;
+
+    if (ring->sqe_tail - LOAD_ACQUIRE(ring->sq_head) >= ring->sq_entries) {
+        return NULL;
+    }
+    sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+    ring->sqe_tail++;
+    return sqe;
+}
+
+/**
+ * Publishes the entries handed out since the last call to the kernel.
+ * @return the number of entries the kernel has not yet consumed.
+ */
+static unsigned int
+flush_sq(struct sigsafe_uring *ring)
+{
+    unsigned int tail = *ring->sq_tail;
+
+    for (; tail != ring->sqe_tail; tail++) {
+        ring->sq_array[tail & ring->sq_mask] = tail & ring->sq_mask;
+    }
+    STORE_RELEASE(ring->sq_tail, tail);
+    return tail - LOAD_ACQUIRE(ring->sq_head);
+}
+
+int
+sigsafe_uring_submit(struct sigsafe_uring *ring)
+{
+    unsigned int pending = flush_sq(ring);
+
+    if (pending == 0) {
+        return 0;
+    }
+    return sigsafe_io_uring_enter(ring->fd, pending, 0, 0, NULL, 0);
+}
+
+int
+sigsafe_uring_reap(struct sigsafe_uring *ring, struct io_uring_cqe *cqes,
+                   unsigned int max)
+{
+    unsigned int head = *ring->cq_head;
+    unsigned int tail = LOAD_ACQUIRE(ring->cq_tail);
+    unsigned int n = 0;
+
+    for (; head != tail && n < max; head++, n++) {
+        cqes[n] = ring->cqes[head & ring->cq_mask];
+    }
+    STORE_RELEASE(ring->cq_head, head);
+    return n;
+}
+
+int
+sigsafe_uring_wait(struct sigsafe_uring *ring, struct io_uring_cqe *cqes,
+                   unsigned int max)
+{
+    for (;;) {
+        int retval = sigsafe_uring_reap(ring, cqes, max);
+        if (retval > 0) {
+            return retval;
+        }
+
+        /*
+         * If a signal interrupts the wait after the kernel has submitted
+         * something, it returns the count instead of -EINTR. The next time
+         * around, the wrapper sees the flag.
+         */
+        retval = sigsafe_io_uring_enter(ring->fd, flush_sq(ring), 1,
+                                        IORING_ENTER_GETEVENTS, NULL, 0);
+        if (retval < 0) {
+            return retval;
+        }
+    }
+}
+
+#endif /* SIGSAFE_HAVE_IO_URING */
@@ -0,0 +1,177 @@
+/** @file
+ * A watchdog thread that interrupts threads blocked past their deadlines.
+ * Threads publish their deadlines in their registry entries with atomic
+ * stores; the watchdog wakes once per tick, walks the registry, and signals
+ * only the overdue ones. One timer serves the whole process.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include "sigsafe_internal.h"
+#include <assert.h>
+#include <errno.h>
+
+#ifdef SIGSAFE_HAVE_INTERRUPT
+/** A deadline_ns the watchdog has claimed and signalled. */
+#define FIRED -1LL
+
+#ifdef _THREAD_SAFE
+#include <pthread.h>
+
+INTERNAL_DEC pthread_key_t sigsafe_key_;
+#ifdef SIGSAFE_HAVE_TLS
+extern __thread struct sigsafe_tsd_* sigsafe_data_
+        __attribute__ ((tls_model ("initial-exec")));
+#endif
+
+static pthread_t watchdog;
+static int watchdog_running;
+static volatile int watchdog_stopping;
+static struct timespec watchdog_tick;
+#else
+INTERNAL_DEC struct sigsafe_tsd_* sigsafe_data_;
+#endif
+
+static long long
+now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+#ifdef _THREAD_SAFE
+static void*
+watchdog_main(void *arg)
+{
+    struct timespec next;
+    sigset_t all;
+
+    /* Process-directed signals should go to threads that want them. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!watchdog_stopping) {
+        struct sigsafe_thread_ *t;
+        long long now;
+
+        next.tv_sec += watchdog_tick.tv_sec;
+        next.tv_nsec += watchdog_tick.tv_nsec;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL)
+               == EINTR) ;
+
+        now = now_ns();
+        for (t = __atomic_load_n(&sigsafe_threads_, __ATOMIC_ACQUIRE);
+             t != NULL; t = t->next) {
+            long long deadline = __atomic_load_n(&t->deadline_ns,
+                                                 __ATOMIC_ACQUIRE);
+
+            /*
+             * Claim the deadline before signalling, so each is fired at most
+             * once, and not at all if the thread got there first. Marking it
+             * FIRED in the same word means disarm can't miss the claim.
+             */
+            if (deadline > 0 && deadline <= now
+                && __atomic_compare_exchange_n(&t->deadline_ns, &deadline,
+                                               FIRED, 0, __ATOMIC_ACQ_REL,
+                                               __ATOMIC_RELAXED)
+                && sigsafe_interrupt_thread(t) != 0) {
+                /* It exited; don't claim a fire that never happened. */
+                deadline = FIRED;
+                __atomic_compare_exchange_n(&t->deadline_ns, &deadline, 0, 0,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_RELAXED);
+            }
+        }
+    }
+    return NULL;
+}
+#endif
+
+int
+sigsafe_watchdog_start(const struct timespec *tick)
+{
+#ifdef _THREAD_SAFE
+    int retval;
+
+    if (watchdog_running) {
+        return -EBUSY;
+    }
+    if (sigsafe_interrupt_signum_ == 0) {
+        return -EINVAL;
+    }
+    if (tick->tv_sec < 0 || tick->tv_nsec < 0 || tick->tv_nsec >= 1000000000
+        || (tick->tv_sec == 0 && tick->tv_nsec == 0)) {
+        return -EINVAL;
+    }
+    watchdog_tick = *tick;
+    watchdog_stopping = 0;
+    retval = pthread_create(&watchdog, NULL, watchdog_main, NULL);
+    if (retval != 0) {
+        return -retval;
+    }
+    watchdog_running = 1;
+    return 0;
+#else
+    return -ENOSYS;
+#endif
+}
+
+void
+sigsafe_watchdog_stop(void)
+{
+#ifdef _THREAD_SAFE
+    if (watchdog_running) {
+        watchdog_stopping = 1;
+        pthread_join(watchdog, NULL);
+        watchdog_running = 0;
+    }
+#endif
+}
+
+/** Returns the calling thread's registry entry. */
+static struct sigsafe_thread_ *
+self(void)
+{
+#ifdef SIGSAFE_TSD_KEY
+    struct sigsafe_tsd_ *sigsafe_data_;
+
+    sigsafe_data_ = (struct sigsafe_tsd_*) pthread_getspecific(sigsafe_key_);
+#endif
+    assert(sigsafe_data_ != NULL);
+    return sigsafe_data_->thread;
+}
+
+void
+sigsafe_watchdog_arm(const struct timespec *timeout)
+{
+    struct sigsafe_thread_ *t = self();
+
+    __atomic_store_n(&t->deadline_ns,
+                     now_ns() + (long long) timeout->tv_sec * 1000000000
+                     + timeout->tv_nsec,
+                     __ATOMIC_RELEASE);
+}
+
+int
+sigsafe_watchdog_disarm(void)
+{
+    struct sigsafe_thread_ *t = self();
+
+    /*
+     * Lose the race to the watchdog and it has signalled or will. Either way
+     * the slot is left clear, so a second disarm doesn't report it again.
+     */
+    return __atomic_exchange_n(&t->deadline_ns, 0, __ATOMIC_ACQ_REL)
+           == FIRED;
+}
+#endif /* SIGSAFE_HAVE_INTERRUPT */
@@ -12,17 +12,15 @@
 #include <unistd.h>
 
 void sigsafe_handler_for_platform_(ucontext_t *ctx) {
-    struct sigsafe_syscall_ *s;
+    const struct sigsafe_jmp_ *j;
     void *pc;
     pc = (void*) ctx->uc_mcontext.gregs[REG_PC];
-    for (s = sigsafe_syscalls_; s->minjmp != NULL; s++) {
-        if (s->minjmp <= pc && pc <= s->maxjmp) {
+    j = sigsafe_lookup_jmp_(pc);
+    if (j != NULL) {
 #ifdef SIGSAFE_DEBUG_JUMP
-            write(2, "[J]", 3);
+        write(2, "[J]", 3);
 #endif
-            ctx->uc_mcontext.gregs[REG_PC ] = (long) s->jmpto;
-            ctx->uc_mcontext.gregs[REG_nPC] = (long) s->jmpto + 4;
-            return;
-        }
+        ctx->uc_mcontext.gregs[REG_PC ] = (long) j->jmpto;
+        ctx->uc_mcontext.gregs[REG_nPC] = (long) j->jmpto + 4;
     }
 }
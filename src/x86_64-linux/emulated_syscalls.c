@@ -20,3 +20,26 @@ sigsafe_send(int s, const void *buf, size_t len, int flags)
 {
     return sendto(s, buf, len, flags, NULL, 0);
 }
+
+#ifdef SIGSAFE_HAVE_PREADV2
+INTERNAL_DEC ssize_t sigsafe_raw_preadv2(int fd, const struct iovec *iov,
+                                         int iovcnt, loff_t pos_l, long pos_h,
+                                         int flags);
+INTERNAL_DEC ssize_t sigsafe_raw_pwritev2(int fd, const struct iovec *iov,
+                                          int iovcnt, loff_t pos_l,
+                                          long pos_h, int flags);
+
+ssize_t
+sigsafe_preadv2(int fd, const struct iovec *iov, int iovcnt, loff_t offset,
+                int flags)
+{
+    return sigsafe_raw_preadv2(fd, iov, iovcnt, offset, 0, flags);
+}
+
+ssize_t
+sigsafe_pwritev2(int fd, const struct iovec *iov, int iovcnt, loff_t offset,
+                 int flags)
+{
+    return sigsafe_raw_pwritev2(fd, iov, iovcnt, offset, 0, flags);
+}
+#endif
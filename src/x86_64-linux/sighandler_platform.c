@@ -13,16 +13,14 @@
 #include <unistd.h>
 
 void sigsafe_handler_for_platform_(ucontext_t *ctx) {
-    struct sigsafe_syscall_ *s;
+    const struct sigsafe_jmp_ *j;
     void *rip;
     rip = (void*) ctx->uc_mcontext.gregs[REG_RIP];
-    for (s = sigsafe_syscalls_; s->minjmp != NULL; s++) {
-        if (s->minjmp <= rip && rip <= s->maxjmp) {
+    j = sigsafe_lookup_jmp_(rip);
+    if (j != NULL) {
 #ifdef SIGSAFE_DEBUG_JUMP
-            write(2, "[J]", 3);
+        write(2, "[J]", 3);
 #endif
-            ctx->uc_mcontext.gregs[REG_RIP] = (long) s->jmpto;
-            return;
-        }
+        ctx->uc_mcontext.gregs[REG_RIP] = (long) j->jmpto;
     }
 }
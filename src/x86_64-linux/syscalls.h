@@ -8,24 +8,79 @@
  */
 
 SYSCALL(accept, 3)
+#ifdef SIGSAFE_HAVE_CLOCK_NANOSLEEP
+SYSCALL(clock_nanosleep, 4)
+#endif
 SYSCALL(connect, 3)
 #ifdef SIGSAFE_HAVE_EPOLL
 SYSCALL(epoll_wait, 4)
 #endif
+#ifdef SIGSAFE_HAVE_EPOLL_PWAIT2
+/* Wrapped in sigsafe_pwait.c. The number is the same on all platforms. */
+#ifndef __NR_epoll_pwait2
+#define __NR_epoll_pwait2 441
+#endif
+#define __NR_raw_epoll_pwait2 __NR_epoll_pwait2
+SYSCALL(raw_epoll_pwait2, 6)
+#endif
+#ifdef SIGSAFE_HAVE_IO_URING
+SYSCALL(io_uring_enter, 6)
+#endif
 SYSCALL(nanosleep, 3)
 SYSCALL(pause, 0)
 SYSCALL(poll, 3)
+#ifdef SIGSAFE_HAVE_PPOLL
+/* ppoll and pselect6 are wrapped in sigsafe_pwait.c. */
+#define __NR_raw_ppoll __NR_ppoll
+SYSCALL(raw_ppoll, 5)
+#endif
+#define __NR_pread __NR_pread64
+SYSCALL(pread, 4)
+#ifdef SIGSAFE_HAVE_PREADV
+/* The kernel ignores preadv's pos_h argument on 64-bit platforms. */
+SYSCALL(preadv, 4)
+#endif
+#ifdef SIGSAFE_HAVE_PREADV2
+/* preadv2's flags go after pos_h; see emulated_syscalls.c. */
+#define __NR_raw_preadv2 __NR_preadv2
+SYSCALL(raw_preadv2, 6)
+#endif
+#ifdef SIGSAFE_HAVE_PSELECT
+#define __NR_raw_pselect6 __NR_pselect6
+SYSCALL(raw_pselect6, 6)
+#endif
+#define __NR_pwrite __NR_pwrite64
+SYSCALL(pwrite, 4)
+#ifdef SIGSAFE_HAVE_PREADV
+SYSCALL(pwritev, 4)
+#endif
+#ifdef SIGSAFE_HAVE_PREADV2
+#define __NR_raw_pwritev2 __NR_pwritev2
+SYSCALL(raw_pwritev2, 6)
+#endif
 SYSCALL(read, 3)
 SYSCALL(readv, 3)
 /* recv is emulated */
 SYSCALL(recvfrom, 6)
 SYSCALL(recvmsg, 3)
+#ifdef SIGSAFE_HAVE_MMSG
+SYSCALL(recvmmsg, 5)
+#endif
 SYSCALL(select, 5)
 /* send is emulated */
 SYSCALL(sendto, 6)
 SYSCALL(sendmsg, 3)
+#ifdef SIGSAFE_HAVE_MMSG
+SYSCALL(sendmmsg, 4)
+#endif
+SYSCALL(sendfile, 4)
 #define __NR_sigsuspend __NR_rt_sigsuspend
 SYSCALL(sigsuspend, 1)
+#ifdef SIGSAFE_HAVE_SPLICE
+SYSCALL(splice, 6)
+SYSCALL(tee, 4)
+SYSCALL(vmsplice, 4)
+#endif
 SYSCALL(write, 3)
 SYSCALL(writev, 3)
 SYSCALL(wait4, 4)
@@ -0,0 +1,134 @@
+/** @file
+ * Compares copying a file through a userspace buffer with sigsafe_read() and
+ * sigsafe_write() against the zero-copy sigsafe_copy(), at several file
+ * sizes. Both copy from one temporary file to another; the source is in the
+ * page cache after the first round, so this measures CPU, not disk.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include <sigsafe.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define BUFFER_SIZE     (64<<10)
+#define BYTES_PER_SIZE  (1<<30)  /* total to copy at each file size */
+#define MAX_FILE_SIZE   (16<<20)
+
+#ifdef SIGSAFE_HAVE_SENDFILE
+static char buffer[BUFFER_SIZE];
+
+static double
+elapsed_s(const struct timeval *before, const struct timeval *after)
+{
+    return   (after->tv_sec  - before->tv_sec )
+           + (after->tv_usec - before->tv_usec) * 1e-6;
+}
+
+static int
+copy_readwrite(int out_fd, int in_fd, size_t size)
+{
+    size_t done = 0;
+
+    while (done < size) {
+        ssize_t r = sigsafe_read(in_fd, buffer, sizeof(buffer)), w = 0;
+        if (r <= 0) {
+            return -1;
+        }
+        while (w < r) {
+            ssize_t n = sigsafe_write(out_fd, buffer + w, r - w);
+            if (n <= 0) {
+                return -1;
+            }
+            w += n;
+        }
+        done += r;
+    }
+    return 0;
+}
+
+static int
+copy_zerocopy(int out_fd, int in_fd, size_t size)
+{
+    size_t copied;
+
+    if (sigsafe_copy(out_fd, in_fd, NULL, size, &copied) != 0
+        || copied != size) {
+        return -1;
+    }
+    return 0;
+}
+
+/** Returns MB/s copying a size-byte file with the given method. */
+static double
+run(int (*method)(int, int, size_t), int src, int dst, size_t size)
+{
+    struct timeval before, after;
+    size_t rounds = BYTES_PER_SIZE / size, i;
+
+    gettimeofday(&before, NULL);
+    for (i = 0; i < rounds; i++) {
+        lseek(src, 0, SEEK_SET);
+        lseek(dst, 0, SEEK_SET);
+        if (method(dst, src, size) != 0) {
+            return -1;
+        }
+    }
+    gettimeofday(&after, NULL);
+    return (double) rounds * size / (1<<20) / elapsed_s(&before, &after);
+}
+
+int
+main(void)
+{
+    FILE *src_f, *dst_f;
+    int src, dst;
+    size_t size;
+
+    sigsafe_install_handler(SIGUSR1, NULL);
+    sigsafe_install_tsd(0, NULL);
+
+    src_f = tmpfile();
+    dst_f = tmpfile();
+    if (src_f == NULL || dst_f == NULL) {
+        perror("tmpfile");
+        return 1;
+    }
+    src = fileno(src_f);
+    dst = fileno(dst_f);
+    memset(buffer, 'x', sizeof(buffer));
+    for (size = 0; size < MAX_FILE_SIZE; size += BUFFER_SIZE) {
+        if (write(src, buffer, BUFFER_SIZE) != BUFFER_SIZE) {
+            perror("write");
+            return 1;
+        }
+    }
+
+    printf("%10s %18s %18s\n", "file size", "read/write (MB/s)",
+           "sigsafe_copy (MB/s)");
+    for (size = 4<<10; size <= MAX_FILE_SIZE; size *= 16) {
+        double rw = run(&copy_readwrite, src, dst, size);
+        double zc = run(&copy_zerocopy, src, dst, size);
+        if (rw < 0 || zc < 0) {
+            fprintf(stderr, "copy failed at size %lu\n",
+                    (unsigned long) size);
+            return 1;
+        }
+        printf("%10lu %18.0f %18.0f\n", (unsigned long) size, rw, zc);
+    }
+    return 0;
+}
+#else
+int
+main(void)
+{
+    printf("sigsafe_copy is not available on this platform.\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,129 @@
+/** @file
+ * Measures how long sigsafe_interrupt_all() takes to get every thread
+ * blocked in sigsafe_read() back to userspace, for 1, 100, and 10,000
+ * threads. This is the critical path of a graceful shutdown.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include <sigsafe.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined(SIGSAFE_HAVE_INTERRUPT) && defined(_THREAD_SAFE)
+#include <pthread.h>
+#include <sched.h>
+
+#define MAX_THREADS     10000
+#define STACK_SIZE      (64*1024)
+
+static int mypipe[2];
+static volatile int ready, failed;
+static struct timespec woke[MAX_THREADS];
+
+static double
+elapsed_us(const struct timespec *before, const struct timespec *after)
+{
+    return   (after->tv_sec  - before->tv_sec ) * 1e6
+           + (after->tv_nsec - before->tv_nsec) / 1e3;
+}
+
+static void*
+worker(void *arg)
+{
+    struct timespec *my_woke = (struct timespec*) arg;
+    char c;
+
+    if (sigsafe_install_tsd(0, NULL) != 0) {
+        failed = 1;
+    }
+    __sync_fetch_and_add(&ready, 1);
+    if (sigsafe_read(mypipe[0], &c, 1) != -EINTR) {
+        failed = 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, my_woke);
+    return NULL;
+}
+
+/**
+ * Starts n threads, waits for them to block, interrupts them all, and
+ * reports how long until the last one returned from its read.
+ */
+static int
+run(int n)
+{
+    static pthread_t threads[MAX_THREADS];
+    struct timespec start, last, pause = { 0, 50000000 };
+    pthread_attr_t attr;
+    int i;
+
+    ready = 0;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, STACK_SIZE);
+    for (i = 0; i < n; i++) {
+        if (pthread_create(&threads[i], &attr, worker, &woke[i]) != 0) {
+            fprintf(stderr, "pthread_create failed after %d threads\n", i);
+            return -1;
+        }
+    }
+    pthread_attr_destroy(&attr);
+    while (ready < n) {
+        sched_yield();
+    }
+    nanosleep(&pause, NULL); /* let the last ones get into the kernel */
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (sigsafe_interrupt_all() < n) {
+        fprintf(stderr, "sigsafe_interrupt_all missed threads\n");
+        return -1;
+    }
+    sigsafe_clear_received();
+    for (i = 0; i < n; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    last = start;
+    for (i = 0; i < n; i++) {
+        if (elapsed_us(&last, &woke[i]) > 0) {
+            last = woke[i];
+        }
+    }
+    if (failed) {
+        fprintf(stderr, "a thread was not interrupted\n");
+        return -1;
+    }
+    printf("%8d %14.1f %14.2f\n", n, elapsed_us(&start, &last),
+           elapsed_us(&start, &last) / n);
+    return 0;
+}
+
+int
+main(void)
+{
+    int n;
+
+    if (pipe(mypipe) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    sigsafe_install_interrupt_handler(SIGRTMIN + 1);
+    sigsafe_install_tsd(0, NULL);
+    printf("%8s %14s %14s\n", "threads", "total (us)", "per thread (us)");
+    for (n = 1; n <= MAX_THREADS; n *= 100) {
+        if (run(n) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+#else
+int
+main(void)
+{
+    printf("sigsafe_interrupt_all is not available in this build.\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,109 @@
+/** @file
+ * Compares periodic loops that sleep a relative interval each tick with
+ * sigsafe_nanosleep() against ones that sleep until each tick's absolute
+ * deadline with sigsafe_clock_nanosleep(TIMER_ABSTIME), at 1 kHz and
+ * 10 kHz. Reports the spread of tick-to-tick intervals and how far the
+ * loop has drifted from its schedule by the end.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include <sigsafe.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#define SECONDS_PER_RUN 1
+
+#ifdef SIGSAFE_HAVE_CLOCK_NANOSLEEP
+static double
+ns_of(const struct timespec *ts)
+{
+    return ts->tv_sec * 1e9 + ts->tv_nsec;
+}
+
+static void
+add_ns(struct timespec *ts, long ns)
+{
+    ts->tv_nsec += ns;
+    while (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * Runs one loop of <tt>ticks</tt> ticks of <tt>period_ns</tt> each, and
+ * prints statistics on the intervals between them.
+ */
+static int
+run(const char *name, long period_ns, int absolute)
+{
+    int ticks = SECONDS_PER_RUN * (1000000000 / period_ns);
+    struct timespec start, prev, now, deadline;
+    struct timespec period = { 0, period_ns };
+    double sum = 0, sumsq = 0, worst = 0;
+    int i, rv;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    prev = deadline = start;
+    for (i = 0; i < ticks; i++) {
+        double interval;
+
+        if (absolute) {
+            add_ns(&deadline, period_ns);
+            rv = sigsafe_clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                         &deadline, NULL);
+        } else {
+            rv = sigsafe_nanosleep(&period, NULL);
+        }
+        if (rv != 0) {
+            fprintf(stderr, "%s: sleep returned %d\n", name, rv);
+            return -1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        interval = ns_of(&now) - ns_of(&prev);
+        sum += interval;
+        sumsq += interval * interval;
+        if (fabs(interval - period_ns) > worst) {
+            worst = fabs(interval - period_ns);
+        }
+        prev = now;
+    }
+    printf("%-10s %6ld %12.2f %12.2f %12.2f %12.1f\n", name,
+           1000000000 / period_ns / 1000, sum / ticks / 1e3,
+           sqrt(sumsq / ticks - (sum / ticks) * (sum / ticks)) / 1e3,
+           worst / 1e3,
+           (ns_of(&now) - ns_of(&start) - (double) ticks * period_ns) / 1e3);
+    return 0;
+}
+
+int
+main(void)
+{
+    static const long periods_ns[] = { 1000000, 100000 };
+    int i;
+
+    sigsafe_install_handler(SIGUSR1, NULL);
+    sigsafe_install_tsd(0, NULL);
+    printf("%-10s %6s %12s %12s %12s %12s\n", "sleep", "kHz", "mean (us)",
+           "stddev (us)", "worst (us)", "drift (us)");
+    for (i = 0; i < sizeof(periods_ns)/sizeof(periods_ns[0]); i++) {
+        if (   run("relative", periods_ns[i], 0) != 0
+            || run("absolute", periods_ns[i], 1) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+#else
+int
+main(void)
+{
+    printf("clock_nanosleep is not available on this platform.\n");
+    return 0;
+}
+#endif
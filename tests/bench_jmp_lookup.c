@@ -0,0 +1,96 @@
+/** @file
+ * Measures the cost of finding the jump region for an interrupted
+ * instruction pointer, as the signal handler does on every safe signal.
+ * Compares the linear scan sigsafe used to do with the sorted search it does
+ * now, for tables of various sizes.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "sigsafe_internal.h"
+
+/*
+ * Each fake wrapper is 32 bytes of "code", of which the middle 8 are its
+ * jump region. Lookups are spread evenly over the whole span, so most land
+ * inside some wrapper but outside its jump region, which is the worst case
+ * for both methods.
+ */
+#define WRAPPER_SIZE    32
+#define LOOKUPS         (1<<22)
+#define MAX_REGIONS     4096
+
+static const struct sigsafe_jmp_ *
+linear_search(const struct sigsafe_jmp_ *jmps, size_t n, void *ip)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        if (jmps[i].minjmp <= ip && ip <= jmps[i].maxjmp) {
+            return &jmps[i];
+        }
+    }
+    return NULL;
+}
+
+static double
+elapsed_ns(const struct timeval *before, const struct timeval *after)
+{
+    return   (after->tv_sec  - before->tv_sec ) * 1e9
+           + (after->tv_usec - before->tv_usec) * 1e3;
+}
+
+int
+main(void)
+{
+    static struct sigsafe_jmp_ jmps[MAX_REGIONS];
+    static char code[MAX_REGIONS * WRAPPER_SIZE];
+    size_t n, i;
+
+    printf("%8s %12s %12s\n", "regions", "linear (ns)", "sorted (ns)");
+    for (n = 16; n <= MAX_REGIONS; n *= 4) {
+        struct timeval before, after;
+        size_t span = n * WRAPPER_SIZE;
+        size_t found_linear = 0, found_sorted = 0;
+        double linear_ns, sorted_ns;
+
+        for (i = 0; i < n; i++) {
+            jmps[i].minjmp = &code[i*WRAPPER_SIZE + 12];
+            jmps[i].maxjmp = &code[i*WRAPPER_SIZE + 20];
+            jmps[i].jmpto  = &code[i*WRAPPER_SIZE + 24];
+        }
+
+        gettimeofday(&before, NULL);
+        for (i = 0; i < LOOKUPS; i++) {
+            if (linear_search(jmps, n, &code[(i*7919) % span]) != NULL) {
+                found_linear++;
+            }
+        }
+        gettimeofday(&after, NULL);
+        linear_ns = elapsed_ns(&before, &after) / LOOKUPS;
+
+        gettimeofday(&before, NULL);
+        for (i = 0; i < LOOKUPS; i++) {
+            if (sigsafe_search_jmp_(jmps, n, &code[(i*7919) % span]) != NULL) {
+                found_sorted++;
+            }
+        }
+        gettimeofday(&after, NULL);
+        sorted_ns = elapsed_ns(&before, &after) / LOOKUPS;
+
+        if (found_linear != found_sorted) {
+            fprintf(stderr, "methods disagree: %lu vs %lu\n",
+                    (unsigned long) found_linear,
+                    (unsigned long) found_sorted);
+            return 1;
+        }
+        printf("%8lu %12.1f %12.1f\n", (unsigned long) n, linear_ns,
+               sorted_ns);
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+/** @file
+ * Compares receiving datagrams one at a time with sigsafe_recvfrom() against
+ * receiving them in batches of various sizes with sigsafe_recvmmsg().
+ * Each round sends a batch over loopback UDP and then drains it, so only
+ * the receive side differs between the runs.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#define _GNU_SOURCE /* for struct mmsghdr */
+#include <sigsafe.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DATAGRAM_SIZE   64
+#define DATAGRAMS       (1<<20)
+#define MAX_BATCH       64
+
+#ifdef SIGSAFE_HAVE_MMSG
+static char bufs[MAX_BATCH][DATAGRAM_SIZE];
+static struct iovec iov[MAX_BATCH];
+static struct mmsghdr msgs[MAX_BATCH];
+
+static double
+elapsed_ns(const struct timeval *before, const struct timeval *after)
+{
+    return   (after->tv_sec  - before->tv_sec ) * 1e9
+           + (after->tv_usec - before->tv_usec) * 1e3;
+}
+
+/** Connects s[1] to s[0] over loopback UDP. */
+static int
+udp_pair(int s[2])
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (   (s[0] = socket(AF_INET, SOCK_DGRAM, 0)) < 0
+        || (s[1] = socket(AF_INET, SOCK_DGRAM, 0)) < 0
+        || bind(s[0], (struct sockaddr*) &addr, sizeof(addr)) != 0
+        || getsockname(s[0], (struct sockaddr*) &addr, &len) != 0
+        || connect(s[1], (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/** Sends n datagrams at once, then receives them n at a time. */
+static double
+run(int s[2], int n)
+{
+    struct timeval before, after;
+    double recv_ns = 0;
+    int i, j, rv;
+
+    for (i = 0; i < DATAGRAMS; i += n) {
+        if (sigsafe_sendmmsg(s[1], msgs, n, 0) != n) {
+            return -1;
+        }
+        gettimeofday(&before, NULL);
+        if (n == 1) {
+            if (sigsafe_recvfrom(s[0], bufs[0], DATAGRAM_SIZE, 0, NULL, NULL)
+                != DATAGRAM_SIZE) {
+                return -1;
+            }
+        } else {
+            for (j = 0; j < n; j += rv) {
+                rv = sigsafe_recvmmsg(s[0], &msgs[j], n - j, 0, NULL);
+                if (rv < 0) {
+                    return -1;
+                }
+            }
+        }
+        gettimeofday(&after, NULL);
+        recv_ns += elapsed_ns(&before, &after);
+    }
+    return recv_ns / DATAGRAMS;
+}
+
+int
+main(void)
+{
+    int s[2];
+    int n, i;
+
+    sigsafe_install_handler(SIGUSR1, NULL);
+    sigsafe_install_tsd(0, NULL);
+    if (udp_pair(s) != 0) {
+        perror("udp_pair");
+        return 1;
+    }
+    for (i = 0; i < MAX_BATCH; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = DATAGRAM_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    printf("%8s %16s\n", "batch", "ns/datagram");
+    for (n = 1; n <= MAX_BATCH; n *= 4) {
+        double ns = run(s, n);
+        if (ns < 0) {
+            fprintf(stderr, "transfer failed at batch size %d\n", n);
+            return 1;
+        }
+        printf("%8d %16.1f%s\n", n, ns, (n == 1) ? " (recvfrom)" : "");
+    }
+    return 0;
+}
+#else
+int
+main(void)
+{
+    printf("recvmmsg is not available on this platform.\n");
+    return 0;
+}
+#endif
@@ -0,0 +1,86 @@
+/** @file
+ * Measures what it costs a compute loop to check for a sigsafe signal on
+ * every iteration: sigsafe_signal_pending_inline(), the out-of-line
+ * sigsafe_signal_pending(), and a bare pthread_getspecific() for comparison,
+ * against a loop that doesn't check at all.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include <sigsafe.h>
+#include <sigsafe_inline.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#ifdef _THREAD_SAFE
+#include <pthread.h>
+#endif
+
+#define ITERATIONS  (1<<26)
+
+/* The "work" each iteration does, kept where the compiler can't elide it. */
+static volatile unsigned long sink;
+
+static double
+elapsed_ns(const struct timeval *before, const struct timeval *after)
+{
+    return   (after->tv_sec  - before->tv_sec ) * 1e9
+           + (after->tv_usec - before->tv_usec) * 1e3;
+}
+
+#ifdef _THREAD_SAFE
+static pthread_key_t key;
+#endif
+
+/*
+ * Times ITERATIONS passes of a loop doing a little work and the given
+ * check, in nanoseconds per iteration. A macro so each check is inlined
+ * into a loop of its own.
+ */
+#define TIME_LOOP(result, check) do {                                       \
+        struct timeval before, after;                                       \
+        unsigned long i, stopped = 0;                                       \
+        gettimeofday(&before, NULL);                                        \
+        for (i = 0; i < ITERATIONS; i++) {                                  \
+            sink += i;                                                      \
+            stopped += (check);                                             \
+        }                                                                   \
+        gettimeofday(&after, NULL);                                         \
+        if (stopped != 0) {                                                 \
+            fprintf(stderr, "unexpected signal\n");                         \
+            abort();                                                        \
+        }                                                                   \
+        (result) = elapsed_ns(&before, &after) / ITERATIONS;                \
+    } while (0)
+
+int
+main(void)
+{
+#ifdef _THREAD_SAFE
+    static int flag;
+#endif
+    double base, t;
+
+    sigsafe_install_handler(SIGALRM, NULL);
+    sigsafe_install_tsd(0, NULL);
+#ifdef _THREAD_SAFE
+    pthread_key_create(&key, NULL);
+    pthread_setspecific(key, &flag);
+#endif
+
+    TIME_LOOP(base, 0);
+    printf("%-32s %8s\n", "check per iteration", "ns/iter");
+    printf("%-32s %8.2f\n", "none", base);
+    TIME_LOOP(t, sigsafe_signal_pending_inline());
+    printf("%-32s %8.2f\n", "sigsafe_signal_pending_inline", t - base);
+    TIME_LOOP(t, sigsafe_signal_pending());
+    printf("%-32s %8.2f\n", "sigsafe_signal_pending", t - base);
+#ifdef _THREAD_SAFE
+    TIME_LOOP(t, *(volatile int*) pthread_getspecific(key) != 0);
+    printf("%-32s %8.2f\n", "pthread_getspecific", t - base);
+#endif
+    return 0;
+}
@@ -0,0 +1,169 @@
+/** @file
+ * Measures the work-stealing pool at 1 to 64 workers: throughput of small
+ * tasks spawned from inside the pool, so idle workers have to steal them,
+ * and the latency from sigsafe_pool_cancel() on a task blocked in
+ * sigsafe_read() to sigsafe_pool_wait() returning for it.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include <sigsafe.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined(SIGSAFE_HAVE_INTERRUPT) && defined(_THREAD_SAFE)
+#include <sched.h>
+
+#define MAX_WORKERS     64
+#define ROOTS           64      /* tasks submitted from outside */
+#define CHILDREN        1000    /* tasks each root submits from inside */
+#define WORK            1000    /* loop iterations per child */
+#define CANCELS         64      /* cancel samples per pool size */
+
+static struct sigsafe_task roots[ROOTS];
+static struct sigsafe_task children[ROOTS][CHILDREN];
+static struct sigsafe_task blockers[MAX_WORKERS];
+static struct sigsafe_pool *pool;
+static int mypipe[2];
+static volatile int started, failed;
+
+/* The "work" each child does, kept where the compiler can't elide it. */
+static volatile unsigned long sink;
+
+static double
+elapsed_us(const struct timespec *before, const struct timespec *after)
+{
+    return   (after->tv_sec  - before->tv_sec ) * 1e6
+           + (after->tv_nsec - before->tv_nsec) / 1e3;
+}
+
+static void
+child(void *arg)
+{
+    unsigned long i, sum = 0;
+
+    for (i = 0; i < WORK; i++) {
+        sum += i;
+    }
+    sink = sum;
+}
+
+static void
+root(void *arg)
+{
+    struct sigsafe_task *mine = (struct sigsafe_task*) arg;
+    int i;
+
+    for (i = 0; i < CHILDREN; i++) {
+        sigsafe_pool_submit(pool, &mine[i], child, NULL);
+    }
+}
+
+static void
+blocker(void *arg)
+{
+    char c;
+
+    __sync_fetch_and_add(&started, 1);
+    if (sigsafe_read(mypipe[0], &c, 1) != -EINTR) {
+        failed = 1;
+    }
+}
+
+/** Returns tasks per second through a pool of n workers. */
+static double
+throughput(void)
+{
+    struct timespec start, stop;
+    int i, j;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < ROOTS; i++) {
+        sigsafe_pool_submit(pool, &roots[i], root, children[i]);
+    }
+    for (i = 0; i < ROOTS; i++) {
+        sigsafe_pool_wait(&roots[i]);
+        for (j = 0; j < CHILDREN; j++) {
+            sigsafe_pool_wait(&children[i][j]);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return ROOTS * (CHILDREN + 1) / (elapsed_us(&start, &stop) / 1e6);
+}
+
+/**
+ * Blocks every one of n workers in a read, cancels each in turn, and
+ * returns the mean time from cancel to wait returning, in microseconds.
+ */
+static double
+cancel_latency(int n)
+{
+    struct timespec before, after, pause = { 0, 1000000 };
+    double total = 0;
+    int samples = 0, i;
+
+    while (samples < CANCELS) {
+        started = 0;
+        for (i = 0; i < n; i++) {
+            sigsafe_pool_submit(pool, &blockers[i], blocker, NULL);
+        }
+        while (started < n) {
+            sched_yield();
+        }
+        nanosleep(&pause, NULL); /* let the last ones get into the kernel */
+        for (i = 0; i < n; i++) {
+            clock_gettime(CLOCK_MONOTONIC, &before);
+            sigsafe_pool_cancel(&blockers[i]);
+            if (sigsafe_pool_wait(&blockers[i]) != -ECANCELED) {
+                failed = 1;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &after);
+            total += elapsed_us(&before, &after);
+            samples++;
+        }
+    }
+    return total / samples;
+}
+
+int
+main(void)
+{
+    double tasks, cancel;
+    int n, rv;
+
+    if (pipe(mypipe) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    sigsafe_install_interrupt_handler(SIGRTMIN + 1);
+    printf("%8s %14s %14s %14s\n", "workers", "tasks/s", "ns/task",
+           "cancel (us)");
+    for (n = 1; n <= MAX_WORKERS; n *= 2) {
+        rv = sigsafe_pool_create(&pool, n);
+        if (rv != 0) {
+            fprintf(stderr, "sigsafe_pool_create: %d\n", rv);
+            return 1;
+        }
+        tasks = throughput();
+        cancel = cancel_latency(n);
+        sigsafe_pool_destroy(pool);
+        if (failed) {
+            fprintf(stderr, "a blocked task was not interrupted\n");
+            return 1;
+        }
+        printf("%8d %14.0f %14.1f %14.2f\n", n, tasks, 1e9 / tasks, cancel);
+    }
+    return 0;
+}
+#else
+int
+main(void)
+{
+    printf("sigsafe_pool is not available in this build.\n");
+    return 0;
+}
+#endif
@@ -24,6 +24,10 @@
 #ifdef DO_SAFE
 #include <sigsafe.h>
 #endif
+#ifdef DO_INLINE
+#include <sigsafe_inline.h>
+#define DO_SAFE
+#endif
 
 /*
  * We want very few bytes per transfer to emphasize the time spent in the
@@ -36,7 +40,9 @@
 
 #define min(a,b) ((a)<(b)?(a):(b))
 
-#ifdef DO_SAFE
+#if defined(DO_INLINE)
+#define MYREAD sigsafe_read_inline
+#elif defined(DO_SAFE)
 #define MYREAD sigsafe_read
 #else
 #define MYREAD read
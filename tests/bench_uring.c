@@ -0,0 +1,162 @@
+/** @file
+ * Compares waiting for readiness with sigsafe_epoll_wait() and then reading
+ * with sigsafe_read() against submitting the read itself through io_uring
+ * and waiting for its completion with sigsafe_uring_wait(), on a pipe and on
+ * a socketpair. Each round writes one small message and then receives it.
+ * @legal
+ * Copyright &copy; 2004 Scott Lamb &lt;slamb@slamb.org&gt;.
+ * This file is part of sigsafe, which is released under the MIT license.
+ * @version     $Id$
+ * @author      Scott Lamb &lt;slamb@slamb.org&gt;
+ */
+
+#include <sigsafe.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define MESSAGE_SIZE    16
+#define ROUNDS          (1<<18)
+
+#if defined(SIGSAFE_HAVE_IO_URING) && defined(SIGSAFE_HAVE_EPOLL)
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+
+static double
+elapsed_ns(const struct timeval *before, const struct timeval *after)
+{
+    return   (after->tv_sec  - before->tv_sec ) * 1e9
+           + (after->tv_usec - before->tv_usec) * 1e3;
+}
+
+static double
+run_epoll(int fds[2])
+{
+    struct timeval before, after;
+    struct epoll_event ev;
+    char buf[MESSAGE_SIZE];
+    int epfd, i;
+
+    if ((epfd = epoll_create(1)) < 0) {
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = fds[0];
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev) != 0) {
+        close(epfd);
+        return -1;
+    }
+    memset(buf, 'x', sizeof(buf));
+    gettimeofday(&before, NULL);
+    for (i = 0; i < ROUNDS; i++) {
+        if (   write(fds[1], buf, sizeof(buf)) != sizeof(buf)
+            || sigsafe_epoll_wait(epfd, &ev, 1, -1) != 1
+            || sigsafe_read(fds[0], buf, sizeof(buf)) != sizeof(buf)) {
+            close(epfd);
+            return -1;
+        }
+    }
+    gettimeofday(&after, NULL);
+    close(epfd);
+    return elapsed_ns(&before, &after) / ROUNDS;
+}
+
+static double
+run_uring(int fds[2])
+{
+    struct timeval before, after;
+    struct sigsafe_uring ring;
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe cqe;
+    char buf[MESSAGE_SIZE];
+    int i;
+
+    if (sigsafe_uring_init(&ring, 8) != 0) {
+        return -1;
+    }
+    memset(buf, 'x', sizeof(buf));
+    gettimeofday(&before, NULL);
+    for (i = 0; i < ROUNDS; i++) {
+        if (write(fds[1], buf, sizeof(buf)) != sizeof(buf)) {
+            break;
+        }
+        sqe = sigsafe_uring_get_sqe(&ring);
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fds[0];
+        sqe->addr = (unsigned long) buf;
+        sqe->len = sizeof(buf);
+        sqe->off = (unsigned long long) -1;
+        if (   sigsafe_uring_wait(&ring, &cqe, 1) != 1
+            || cqe.res != sizeof(buf)) {
+            break;
+        }
+    }
+    gettimeofday(&after, NULL);
+    sigsafe_uring_destroy(&ring);
+    if (i != ROUNDS) {
+        return -1;
+    }
+    return elapsed_ns(&before, &after) / ROUNDS;
+}
+
+static int
+run(const char *name, int fds[2])
+{
+    double epoll_ns = run_epoll(fds);
+    double uring_ns = run_uring(fds);
+
+    if (epoll_ns < 0 || uring_ns < 0) {
+        fprintf(stderr, "transfer failed on %s\n", name);
+        return -1;
+    }
+    printf("%-12s %14.1f %14.1f\n", name, epoll_ns, uring_ns);
+    return 0;
+}
+
+int
+main(void)
+{
+    struct sigsafe_uring ring;
+    int fds[2];
+    int retval;
+
+    sigsafe_install_handler(SIGUSR1, NULL);
+    sigsafe_install_tsd(0, NULL);
+    if ((retval = sigsafe_uring_init(&ring, 1)) != 0) {
+        printf("io_uring is not available: %s\n", strerror(-retval));
+        return 0;
+    }
+    sigsafe_uring_destroy(&ring);
+
+    printf("%-12s %14s %14s\n", "", "epoll (ns)", "io_uring (ns)");
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    if (run("pipe", fds) != 0) {
+        return 1;
+    }
+    close(fds[0]);
+    close(fds[1]);
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        perror("socketpair");
+        return 1;
+    }
+    if (run("socketpair", fds) != 0) {
+        return 1;
+    }
+    close(fds[0]);
+    close(fds[1]);
+    return 0;
+}
+#else
+int
+main(void)
+{
+    printf("io_uring is not available on this platform.\n");
+    return 0;
+}
+#endif
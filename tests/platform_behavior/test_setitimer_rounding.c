@@ -17,6 +17,11 @@
  * See <a
  * href="http://www.opengroup.org/onlinepubs/007904975/functions/setitimer.html">the
  * specification</a>.
+ *
+ * Then measures how closely each of sigsafe's timed waits actually wakes up
+ * to the requested timeout: the millisecond <tt>poll(2)</tt> and
+ * <tt>epoll_wait(2)</tt>, and the nanosecond <tt>ppoll(2)</tt>,
+ * <tt>pselect(2)</tt>, and <tt>epoll_pwait2(2)</tt> where available.
  * @legal
  * Copyright &copy; 2004 &lt;slamb@slamb.org&gt;.
  * This file is part of sigsafe, which is released under the MIT license.
@@ -32,6 +37,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <time.h>
+#include <sigsafe.h>
+
+#define ROUNDS 200
 
 int
 error_wrap(int retval, const char *funcname)
@@ -46,6 +54,151 @@ error_wrap(int retval, const char *funcname)
 
 volatile sig_atomic_t sigalrm_received;
 
+static int never_ready_fd;
+#ifdef SIGSAFE_HAVE_EPOLL
+static int never_ready_epfd;
+#endif
+
+/*
+ * Each of these waits for the given timeout on a pipe nobody writes to. The
+ * millisecond ones round up, as the kernel would.
+ */
+
+static int
+ms_of(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000 + (ts->tv_nsec + 999999) / 1000000;
+}
+
+#ifdef SIGSAFE_HAVE_POLL
+static int
+wait_poll(const struct timespec *ts)
+{
+    struct pollfd pfd = { .fd = never_ready_fd, .events = POLLIN };
+    return sigsafe_poll(&pfd, 1, ms_of(ts));
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_EPOLL
+static int
+wait_epoll_wait(const struct timespec *ts)
+{
+    struct epoll_event ev;
+    return sigsafe_epoll_wait(never_ready_epfd, &ev, 1, ms_of(ts));
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_PPOLL
+static int
+wait_ppoll(const struct timespec *ts)
+{
+    struct pollfd pfd = { .fd = never_ready_fd, .events = POLLIN };
+    return sigsafe_ppoll(&pfd, 1, ts);
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_PSELECT
+static int
+wait_pselect(const struct timespec *ts)
+{
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(never_ready_fd, &readfds);
+    return sigsafe_pselect(never_ready_fd + 1, &readfds, NULL, NULL, ts);
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_EPOLL_PWAIT2
+static int
+wait_epoll_pwait2(const struct timespec *ts)
+{
+    struct epoll_event ev;
+    return sigsafe_epoll_pwait2(never_ready_epfd, &ev, 1, ts);
+}
+#endif
+
+static const struct {
+    const char *name;
+    int (*wait)(const struct timespec *);
+} waits[] = {
+#ifdef SIGSAFE_HAVE_POLL
+    { "poll",           wait_poll },
+#endif
+#ifdef SIGSAFE_HAVE_EPOLL
+    { "epoll_wait",     wait_epoll_wait },
+#endif
+#ifdef SIGSAFE_HAVE_PPOLL
+    { "ppoll",          wait_ppoll },
+#endif
+#ifdef SIGSAFE_HAVE_PSELECT
+    { "pselect",        wait_pselect },
+#endif
+#ifdef SIGSAFE_HAVE_EPOLL_PWAIT2
+    { "epoll_pwait2",   wait_epoll_pwait2 },
+#endif
+};
+
+static double
+elapsed_us(const struct timespec *before, const struct timespec *after)
+{
+    return   (after->tv_sec  - before->tv_sec ) * 1e6
+           + (after->tv_nsec - before->tv_nsec) / 1e3;
+}
+
+/** Prints the mean and worst oversleep of each wait for several timeouts. */
+static void
+measure_precision(void)
+{
+    static const long requested_ns[] = { 10000, 100000, 1000000 };
+    int mypipe[2];
+    int i, j, k;
+
+    error_wrap(pipe(mypipe), "pipe");
+    never_ready_fd = mypipe[0];
+#ifdef SIGSAFE_HAVE_EPOLL
+    {
+        struct epoll_event ev = { .events = EPOLLIN };
+        never_ready_epfd = error_wrap(epoll_create(1), "epoll_create");
+        error_wrap(epoll_ctl(never_ready_epfd, EPOLL_CTL_ADD, never_ready_fd,
+                             &ev), "epoll_ctl");
+    }
+#endif
+
+    printf("\n%-14s %10s %14s %14s\n", "wait", "requested",
+           "mean over (us)", "max over (us)");
+    for (i = 0; i < sizeof(waits)/sizeof(waits[0]); i++) {
+        for (j = 0; j < sizeof(requested_ns)/sizeof(requested_ns[0]); j++) {
+            struct timespec ts = { 0, requested_ns[j] };
+            double sum = 0, max = 0;
+
+            for (k = 0; k < ROUNDS; k++) {
+                struct timespec before, after;
+                double over;
+
+                clock_gettime(CLOCK_MONOTONIC, &before);
+                if (waits[i].wait(&ts) != 0) {
+                    fprintf(stderr, "%s did not time out\n", waits[i].name);
+                    abort();
+                }
+                clock_gettime(CLOCK_MONOTONIC, &after);
+                over = elapsed_us(&before, &after) - requested_ns[j] / 1e3;
+                sum += over;
+                if (over > max) {
+                    max = over;
+                }
+            }
+            printf("%-14s %8ldus %14.1f %14.1f\n", waits[i].name,
+                   requested_ns[j] / 1000, sum / ROUNDS, max);
+        }
+    }
+
+#ifdef SIGSAFE_HAVE_EPOLL
+    close(never_ready_epfd);
+#endif
+    close(mypipe[0]);
+    close(mypipe[1]);
+}
+
 void
 sigalrm_handler(int signum)
 {
@@ -78,11 +231,12 @@ main(void)
     while ((retval = nanosleep(&ts, &ts)) == -1 && errno == EINTR) ;
     error_wrap(retval, "nanosleep");
 
-    if (sigalrm_received) {
-        printf("SIGALRM received; good.\n");
-        return 0;
-    } else {
+    if (!sigalrm_received) {
         printf("SIGALRM was lost.\n");
         return 1;
     }
+    printf("SIGALRM received; good.\n");
+
+    measure_precision();
+    return 0;
 }
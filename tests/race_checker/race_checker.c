@@ -124,6 +124,43 @@ struct test {
         .expected =         SUCCESS,
         .in_most =          1
     },
+#ifdef SIGSAFE_HAVE_SYSCALL
+    {
+        .name =             "sigsafe_syscall_read",
+        .pre_fork_setup =   &create_pipe,
+        .child_setup =      &install_safe,
+        .instrumented =     &do_sigsafe_syscall_read,
+        .nudge =            &nudge_read,
+        .teardown =         &cleanup_pipe,
+        .result =           NOT_RUN,
+        .expected =         SUCCESS,
+        .in_most =          1
+    },
+    {
+        .name =             "sigsafe_batch",
+        .pre_fork_setup =   &create_batch_pipes,
+        .child_setup =      &install_safe,
+        .instrumented =     &do_sigsafe_batch,
+        .nudge =            &nudge_read,
+        .teardown =         &cleanup_batch_pipes,
+        .result =           NOT_RUN,
+        .expected =         SUCCESS,
+        .in_most =          1
+    },
+#endif
+#ifdef SIGSAFE_HAVE_MMSG
+    {
+        .name =             "sigsafe_recvmmsg",
+        .pre_fork_setup =   &create_dgram_pair,
+        .child_setup =      &install_safe,
+        .instrumented =     &do_sigsafe_recvmmsg,
+        .nudge =            &nudge_mmsg,
+        .teardown =         &cleanup_pipe,
+        .result =           NOT_RUN,
+        .expected =         SUCCESS,
+        .in_most =          1
+    },
+#endif
 #ifdef SIGSAFE_HAVE_SELECT
     {
         .name =             "sigsafe_select_read",
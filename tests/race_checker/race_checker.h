@@ -13,6 +13,7 @@
 #include <sys/types.h>      /* for pid_t */
 #include <signal.h>         /* for sig_atomic_t */
 #include <setjmp.h>         /* for sigsetjmp */
+#include <sigsafe_config.h> /* for SIGSAFE_HAVE_xxx */
 
 /** Type of error return; used by error_wrap */
 enum error_return_type {
@@ -60,14 +61,21 @@ enum run_result do_install_safe(void*);
  */
 /*@{*/
 void* create_pipe(void);
+void* create_dgram_pair(void);
+void* create_batch_pipes(void);
 void cleanup_pipe(void*);
+void cleanup_batch_pipes(void*);
 void do_sigsafe_select_read_child_setup(void*);
 
 enum run_result do_sigsafe_read(void*);
 enum run_result do_sigsafe_select_read(void*);
+enum run_result do_sigsafe_syscall_read(void*);
+enum run_result do_sigsafe_batch(void*);
+enum run_result do_sigsafe_recvmmsg(void*);
 enum run_result do_racebefore_read(void*);
 enum run_result do_raceafter_read(void*);
 void nudge_read(void*);
+void nudge_mmsg(void*);
 /*@}*/
 
 #endif /* !RACECHECKER_H */
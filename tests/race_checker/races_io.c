@@ -7,8 +7,10 @@
  * @author          Scott Lamb &lt;slamb@slamb.org&gt;
  */
 
+#define _GNU_SOURCE /* for struct mmsghdr */
 #include <sys/types.h>
 #include <sys/select.h>
+#include <sys/socket.h>
 #include <assert.h>
 #include <string.h>
 #include <unistd.h>
@@ -18,6 +20,9 @@
 #include <sys/wait.h>
 #include <errno.h>
 #include <sigsafe.h>
+#ifdef SIGSAFE_HAVE_SYSCALL
+#include <sys/syscall.h>
+#endif
 #include "race_checker.h"
 
 enum pipe_half {
@@ -45,6 +50,20 @@ cleanup_pipe(void *test_data)
     free(test_data);
 }
 
+#ifdef SIGSAFE_HAVE_MMSG
+void*
+create_dgram_pair(void)
+{
+    void *test_data = NULL;
+
+    test_data = malloc(sizeof(int)*2);
+    assert(test_data != NULL);
+    error_wrap(socketpair(AF_UNIX, SOCK_DGRAM, 0, (int*) test_data),
+               "socketpair", ERRNO);
+    return test_data;
+}
+#endif
+
 #ifdef SIGSAFE_HAVE_SELECT
 void
 do_sigsafe_select_read_child_setup(void *test_data)
@@ -77,6 +96,164 @@ do_sigsafe_read(void *test_data)
     }
 }
 
+#ifdef SIGSAFE_HAVE_SYSCALL
+enum run_result
+do_sigsafe_syscall_read(void *test_data)
+{
+    char c;
+    int *mypipe = (int*) test_data;
+    long retval;
+
+    retval = sigsafe_syscall(SYS_read, mypipe[READ], &c, sizeof(char));
+    if (retval == -EINTR) {
+        return INTERRUPTED;
+    } else if (retval == 1) {
+        return NORMAL;
+    } else {
+        return WEIRD;
+    }
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_SYSCALL
+/*
+ * sigsafe_batch's test data: the pipe nudge_read writes to, which the second
+ * op blocks reading, then one the first op writes to without blocking.
+ */
+void*
+create_batch_pipes(void)
+{
+    int *pipes;
+
+    pipes = malloc(sizeof(int)*4);
+    assert(pipes != NULL);
+    error_wrap(pipe(&pipes[0]), "pipe", ERRNO);
+    error_wrap(pipe(&pipes[2]), "pipe", ERRNO);
+    error_wrap(fcntl(pipes[2 + READ], F_SETFL, O_NONBLOCK), "fcntl", ERRNO);
+    return pipes;
+}
+
+void
+cleanup_batch_pipes(void *test_data)
+{
+    int *pipes = (int*) test_data;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        error_wrap(close(pipes[i]), "close", ERRNO);
+    }
+    free(test_data);
+}
+
+/**
+ * Writes to one pipe, then blocks reading another. Wherever the signal
+ * lands, every op reported complete must have happened and kept its result,
+ * and the one reported interrupted must not have happened.
+ */
+enum run_result
+do_sigsafe_batch(void *test_data)
+{
+    int *pipes = (int*) test_data;
+    char in, out = 'x', check;
+    struct sigsafe_op ops[2];
+    int retval, written;
+
+    memset(ops, 0, sizeof(ops));
+    ops[0].number = SYS_write;
+    ops[0].args[0] = pipes[2 + WRITE];
+    ops[0].args[1] = (long) &out;
+    ops[0].args[2] = sizeof(char);
+    ops[1].number = SYS_read;
+    ops[1].args[0] = pipes[READ];
+    ops[1].args[1] = (long) &in;
+    ops[1].args[2] = sizeof(char);
+
+    retval = sigsafe_batch(ops, 2);
+    written = (read(pipes[2 + READ], &check, sizeof(char)) == 1);
+    if (retval == 0) {
+        return (ops[0].result == -EINTR && !written) ? INTERRUPTED : WEIRD;
+    } else if (ops[0].result != 1 || !written) {
+        return WEIRD; /* a completed op's result was lost */
+    } else if (retval == 1) {
+        return (ops[1].result == -EINTR) ? INTERRUPTED : WEIRD;
+    } else if (retval == 2 && ops[1].result == 1) {
+        return NORMAL;
+    }
+    return WEIRD;
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_MMSG
+#define MMSG_BATCH 2
+
+/**
+ * Receives the batch sent by nudge_mmsg.
+ * With MSG_WAITFORONE, the kernel may return after the first datagram. If
+ * so, the rest must still be queued: a signal must never cost us datagrams
+ * already taken off the socket.
+ */
+enum run_result
+do_sigsafe_recvmmsg(void *test_data)
+{
+    char bufs[MMSG_BATCH];
+    struct iovec iov[MMSG_BATCH];
+    struct mmsghdr msgs[MMSG_BATCH];
+    int *sockets = (int*) test_data;
+    int retval, got, i;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < MMSG_BATCH; i++) {
+        iov[i].iov_base = &bufs[i];
+        iov[i].iov_len = sizeof(char);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    retval = sigsafe_recvmmsg(sockets[READ], msgs, MMSG_BATCH,
+                              MSG_WAITFORONE, NULL);
+    if (retval == -EINTR) {
+        return INTERRUPTED;
+    } else if (retval < 1) {
+        return WEIRD;
+    }
+    got = retval;
+    if (got < MMSG_BATCH) {
+        retval = recvmmsg(sockets[READ], &msgs[got], MMSG_BATCH - got,
+                          MSG_DONTWAIT, NULL);
+        if (retval != MMSG_BATCH - got) {
+            return WEIRD;
+        }
+    }
+    for (i = 0; i < MMSG_BATCH; i++) {
+        if (msgs[i].msg_len != 1 || bufs[i] != 'a' + i) {
+            return WEIRD;
+        }
+    }
+    return NORMAL;
+}
+
+void
+nudge_mmsg(void *test_data)
+{
+    char bufs[MMSG_BATCH];
+    struct iovec iov[MMSG_BATCH];
+    struct mmsghdr msgs[MMSG_BATCH];
+    int *sockets = (int*) test_data;
+    int i;
+
+    memset(msgs, 0, sizeof(msgs));
+    for (i = 0; i < MMSG_BATCH; i++) {
+        bufs[i] = 'a' + i;
+        iov[i].iov_base = &bufs[i];
+        iov[i].iov_len = sizeof(char);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    i = error_wrap(sendmmsg(sockets[WRITE], msgs, MMSG_BATCH, 0),
+                   "sendmmsg", ERRNO);
+    assert(i == MMSG_BATCH);
+}
+#endif
+
 #ifdef SIGSAFE_HAVE_SELECT
 enum run_result
 do_sigsafe_select_read(void *test_data)
@@ -1,11 +1,24 @@
+#define _GNU_SOURCE /* for RWF_NOWAIT */
 #ifdef _THREAD_SAFE
 #include <pthread.h>
+#include <sched.h>
 #endif
 #include <sigsafe.h>
+#include <sigsafe_inline.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#ifdef SIGSAFE_HAVE_SYSCALL
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#endif
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#ifdef SIGSAFE_HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
 
 sig_atomic_t volatile tsd;
 
@@ -145,184 +158,1870 @@ int test_nanosleep(void) {
 #undef ALLOWED_EXTRA_US
 }
 
-void
-test_userhandler_handler(int signo, siginfo_t *si, ucontext_t *ctx,
-                         intptr_t user_data)
+#ifdef SIGSAFE_HAVE_CLOCK_NANOSLEEP
+/**
+ * Tests sigsafe_clock_nanosleep() with an absolute deadline: it wakes no
+ * earlier than the deadline, and a signal before or during the sleep cuts
+ * it short.
+ */
+int
+test_clock_nanosleep(void)
 {
-    sig_atomic_t volatile *tsd = (sig_atomic_t volatile *) user_data;
+    struct itimerval it = {
+        .it_interval = { .tv_sec = 0, .tv_usec = 0 },
+        .it_value = { .tv_sec = 0, .tv_usec = 500 }
+    };
+    struct timespec deadline, now;
+    int rv;
 
-    if (*tsd != 26) {
-        abort();
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
     }
-    *tsd = 37;
+    rv = sigsafe_clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+                                 NULL);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (rv != 0 || now.tv_sec < deadline.tv_sec
+        || (now.tv_sec == deadline.tv_sec && now.tv_nsec < deadline.tv_nsec)) {
+        printf("(deadline: returned %d) ", rv);
+        return 1;
+    }
+
+    deadline.tv_sec += 10;
+    raise(SIGALRM);
+    rv = sigsafe_clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+                                 NULL);
+    sigsafe_clear_received();
+    if (rv != -EINTR) {
+        printf("(early: returned %d) ", rv);
+        return 1;
+    }
+
+    error_wrap(setitimer(ITIMER_REAL, &it, NULL), "setitimer", ERRNO);
+    rv = sigsafe_clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+                                 NULL);
+    sigsafe_clear_received();
+    if (rv != -EINTR) {
+        printf("(blocked: returned %d) ", rv);
+        return 1;
+    }
+    return 0;
 }
+#endif
 
 /**
- * Tests that the userhandler is invoked with the correct info.
+ * Tests that sigsafe_signal_pending() and its inline version see the flag
+ * without clearing it.
  */
 int
-test_userhandler(void)
+test_signal_pending(void)
 {
-    sigsafe_install_handler(SIGUSR1, test_userhandler_handler);
-    tsd = 26;
-    raise(SIGUSR1);
     sigsafe_clear_received();
-    if (tsd != 37) {
+    if (sigsafe_signal_pending() || sigsafe_signal_pending_inline()) {
+        printf("(pending before signal) ");
         return 1;
     }
-
-    return 0;
+    raise(SIGALRM);
+    if (!sigsafe_signal_pending() || !sigsafe_signal_pending_inline()
+        || !sigsafe_signal_pending()) {
+        printf("(not pending after signal) ");
+        return 1;
+    }
+    sigsafe_clear_received();
+    return sigsafe_signal_pending_inline() ? 1 : 0;
 }
 
-#ifdef _THREAD_SAFE
-#define MAGIC_INIT          73
-#define MAGIC_BEFORESIG     26
-#define MAGIC_SIG           37
-#define MAGIC_AFTERSIG      17
-#define MAGIC_DESTRUCTOR    42
+static volatile intptr_t tsd_static_destroyed;
 
 static void
-test_tsd_usr1(int signo, siginfo_t *si, ucontext_t *ctx, intptr_t user_data)
+tsd_static_destructor(intptr_t user_data)
 {
-    sig_atomic_t volatile *subthread_tsd = (sig_atomic_t volatile *) user_data;
-
-    if (*subthread_tsd != MAGIC_BEFORESIG) {
-        abort();
-    }
-    *subthread_tsd = MAGIC_SIG;
+    tsd_static_destroyed = user_data;
 }
 
-static void
-subthread_tsd_destructor(intptr_t tsd)
+/**
+ * Tests sigsafe_install_tsd_static() and sigsafe_remove_tsd(): the flag
+ * works from caller-owned storage, removing runs the destructor and stops
+ * signals from being recorded, and the thread can install again afterward.
+ */
+int
+test_tsd_static(void)
 {
-    sig_atomic_t volatile *subthread_tsd = (sig_atomic_t volatile *) tsd;
+    struct sigsafe_tsd_storage storage;
+    intptr_t user_data = sigsafe_clear_received();
+    int res = 1;
 
-    if (*subthread_tsd != MAGIC_AFTERSIG) {
-        abort();
+    sigsafe_remove_tsd();
+    memset(&storage, 0xff, sizeof(storage));
+    error_wrap(sigsafe_install_tsd_static(&storage, 42, tsd_static_destructor),
+               "sigsafe_install_tsd_static", NEGATIVE);
+    raise(SIGALRM);
+    if (!sigsafe_signal_pending() || sigsafe_clear_received() != 42) {
+        printf("(signal not recorded in static storage) ");
+        goto out;
     }
-    *subthread_tsd = MAGIC_DESTRUCTOR;
+    tsd_static_destroyed = 0;
+    sigsafe_remove_tsd();
+    if (tsd_static_destroyed != 42) {
+        printf("(destructor not run) ");
+        goto out;
+    }
+    raise(SIGALRM);
+    if (sigsafe_signal_pending()) {
+        printf("(signal recorded after removal) ");
+        goto out;
+    }
+    res = 0;
+
+out:
+    sigsafe_remove_tsd();
+    error_wrap(sigsafe_install_tsd(user_data, NULL), "sigsafe_install_tsd",
+               NEGATIVE);
+    return res;
 }
 
-static void*
-test_tsd_subthread(void *arg)
+#ifdef SIGSAFE_HAVE_LAZY_TSD
+/**
+ * Tests sigsafe_enable_lazy_tsd(): once it is on, a thread with no TSD gets
+ * some on its first sigsafe call, through both the out-of-line and inline
+ * wrappers, and then sees <tt>-EINTR</tt> like any other; the thread's own
+ * sigsafe_install_tsd() then replaces it. Turns lazy mode off again, so the
+ * rest of the suite runs without it.
+ */
+int
+test_lazy_tsd(void)
 {
-    sig_atomic_t volatile *subthread_tsd = (sig_atomic_t volatile *) arg;
+    intptr_t user_data = sigsafe_clear_received();
+    int mypipe[2];
+    char c;
+    int rv, res = 1;
 
-    error_wrap(sigsafe_install_tsd((intptr_t) subthread_tsd,
-                                   subthread_tsd_destructor),
-               "sigsafe_install_tsd", NEGATIVE);
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    fcntl(mypipe[0], F_SETFL, O_NONBLOCK);
+    error_wrap(sigsafe_enable_lazy_tsd(4), "sigsafe_enable_lazy_tsd",
+               NEGATIVE);
 
-    if (*subthread_tsd != MAGIC_INIT) {
-        return (void*) 1;
+    sigsafe_remove_tsd();
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    if (rv != -EAGAIN) {
+        printf("(first read returned %d) ", rv);
+        goto out;
     }
-    *subthread_tsd = MAGIC_BEFORESIG;
-    error_wrap(sigsafe_install_handler(SIGUSR1, test_tsd_usr1),
-               "sigsafe_install_handler", NEGATIVE);
-    pthread_kill(pthread_self(), SIGUSR1);
-    /*
-     * Note: never clearing received.
-     * This should not affect the main thread.
-     */
-    if (*subthread_tsd != MAGIC_SIG) {
-        return (void*) 1;
+    raise(SIGALRM);
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    if (rv != -EINTR || sigsafe_clear_received() != 0) {
+        printf("(out-of-line: read returned %d) ", rv);
+        goto out;
     }
-    *subthread_tsd = MAGIC_AFTERSIG;
 
-    return (void*) 0;
+    sigsafe_remove_tsd();
+    rv = sigsafe_read_inline(mypipe[0], &c, 1);
+    if (rv != -EAGAIN) {
+        printf("(first inline read returned %d) ", rv);
+        goto out;
+    }
+    raise(SIGALRM);
+    rv = sigsafe_read_inline(mypipe[0], &c, 1);
+    sigsafe_clear_received();
+    if (rv != -EINTR) {
+        printf("(inline: read returned %d) ", rv);
+        goto out;
+    }
+
+    /* The thread's own install replaces the TSD it got lazily. */
+    rv = sigsafe_install_tsd(42, NULL);
+    if (rv != 0 || sigsafe_clear_received() != 42) {
+        printf("(install over lazy TSD returned %d) ", rv);
+        goto out;
+    }
+    raise(SIGALRM);
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    sigsafe_clear_received();
+    if (rv != -EINTR) {
+        printf("(replaced: read returned %d) ", rv);
+        goto out;
+    }
+
+    /* Once off, a thread without TSD ignores signals again. */
+    sigsafe_disable_lazy_tsd();
+    sigsafe_remove_tsd();
+    raise(SIGALRM);
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    if (rv != -EAGAIN) {
+        printf("(disabled: read returned %d) ", rv);
+        goto out;
+    }
+    res = 0;
+
+out:
+    sigsafe_disable_lazy_tsd();
+    sigsafe_remove_tsd();
+    error_wrap(sigsafe_install_tsd(user_data, NULL), "sigsafe_install_tsd",
+               NEGATIVE);
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
 }
 
-int
-test_tsd(void)
+#ifdef _THREAD_SAFE
+static int lazy_reserve_pipe[2], lazy_reserve_block[2];
+static volatile int lazy_reserve_result;
+
+/**
+ * Makes a sigsafe call to get TSD lazily, then reports whether it has some
+ * (a signal to itself interrupts the next call), and stays alive holding it.
+ */
+static void*
+test_lazy_tsd_reserve_subthread(void *arg)
 {
-    pthread_t subthread;
-    sig_atomic_t volatile subthread_tsd = MAGIC_INIT;
-    void *vres;
-    int ires;
-    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1 };
+    char c;
 
-    tsd = 0;
+    sigsafe_read(lazy_reserve_pipe[0], &c, 1);
+    pthread_kill(pthread_self(), SIGALRM);
+    lazy_reserve_result = sigsafe_read(lazy_reserve_pipe[0], &c, 1);
+    while (read(lazy_reserve_block[0], &c, 1) != 0) ; /* until exit */
+    return NULL;
+}
 
-    error_wrap(pthread_create(&subthread, NULL, test_tsd_subthread,
-                              (void*) &subthread_tsd),
-               "pthread_create", DIRECT);
-    error_wrap(pthread_join(subthread, &vres),
-               "pthread_join", DIRECT);
-    if (vres != 0) {
-        printf("(subthread failed) ");
-        return 1;
+/**
+ * In a child process, so the suite keeps its state: starts threads that get
+ * TSD lazily until the reserve runs out. The next thread must go without
+ * (no allocating from inside a wrapper) rather than fail or crash.
+ */
+static int
+lazy_tsd_reserve_child(void)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+    int i;
+
+    if (sigsafe_enable_lazy_tsd(1) != 0 || pipe(lazy_reserve_pipe) != 0
+        || pipe(lazy_reserve_block) != 0) {
+        return 2;
     }
-    if (subthread_tsd != MAGIC_DESTRUCTOR) {
-        printf("(destructor didn't run; subthread_tsd=*%p=%d tsd=*%p=%d) ",
-               &subthread_tsd, subthread_tsd, &tsd, tsd);
-        return 1;
+    fcntl(lazy_reserve_pipe[0], F_SETFL, O_NONBLOCK);
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64*1024);
+    for (i = 0; i < 1000; i++) {
+        lazy_reserve_result = 0;
+        if (pthread_create(&thread, &attr, test_lazy_tsd_reserve_subthread,
+                           NULL) != 0) {
+            return 3;
+        }
+        while (lazy_reserve_result == 0) {
+            sched_yield();
+        }
+        if (lazy_reserve_result == -EAGAIN) {
+            return (i > 0) ? 0 : 4; /* out, but only after the reserve */
+        } else if (lazy_reserve_result != -EINTR) {
+            return 5;
+        }
     }
+    return 6; /* never ran out; it must be allocating */
+}
+#endif
 
-    /* Subthread's flag shouldn't be honored here. */
-    ires = sigsafe_nanosleep(&ts, NULL);
-    if (ires != 0) {
-        printf("(sigsafe_nanosleep failed) ");
+/**
+ * Tests that lazy install stops at the reserve instead of allocating.
+ */
+int
+test_lazy_tsd_reserve(void)
+{
+#ifdef _THREAD_SAFE
+    pid_t pid;
+    int status;
+
+    pid = fork();
+    error_wrap(pid, "fork", ERRNO);
+    if (pid == 0) {
+        _exit(lazy_tsd_reserve_child());
+    }
+    error_wrap(waitpid(pid, &status, 0), "waitpid", ERRNO);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("(child status %d) ", status);
         return 1;
     }
-
+#endif
     return 0;
 }
-#undef MAGIC_INIT
-#undef MAGIC_BEFORESIG
-#undef MAGIC_SIG
-#undef MAGIC_AFTERSIG
-#undef MAGIC_DESTRUCTOR
 #endif
 
-/* Tests that sigsafe_read() works. */
+/**
+ * Tests that sigsafe_fetch_received() reports which signals arrived and how
+ * often, and clears the flag.
+ */
 int
-test_read(void)
+test_fetch_received(void)
 {
+    unsigned int counts[NSIG];
+    sigset_t set;
     int mypipe[2];
-    int res;
-    REGISTERS_DECLARATION;
-    char buf[4];
+    char c;
+    int rv, res = 1;
 
+    error_wrap(sigsafe_install_handler(SIGUSR2, NULL),
+               "sigsafe_install_handler", NEGATIVE);
     error_wrap(pipe(mypipe), "pipe", ERRNO);
-    res = write(mypipe[1], "asdf", 4); /* <PIPE_BUF; complete without block */
-    if (res != 4) {
-        printf("(setup failure) ");
-        res = 1;
-        goto out;
-    }
+    fcntl(mypipe[0], F_SETFL, O_NONBLOCK);
 
-    REGISTERS_PRE;
-    res = sigsafe_read(mypipe[0], buf, 4);
-    if (REGISTERS_WRONG) {
-        printf("(bad registers) ");
-        res = 1;
+    sigsafe_fetch_received(NULL, NULL, 0);
+    raise(SIGALRM);
+    raise(SIGUSR2);
+    raise(SIGALRM);
+    sigsafe_fetch_received(&set, counts, NSIG);
+    if (   !sigismember(&set, SIGALRM) || counts[SIGALRM] != 2
+        || !sigismember(&set, SIGUSR2) || counts[SIGUSR2] != 1
+        || sigismember(&set, SIGUSR1) || counts[SIGUSR1] != 0) {
+        printf("(SIGALRM %d/%u, SIGUSR2 %d/%u) ", sigismember(&set, SIGALRM),
+               counts[SIGALRM], sigismember(&set, SIGUSR2), counts[SIGUSR2]);
         goto out;
     }
-    if (res != 4) {
-        printf("(returned %d) ", res);
-        res = 1;
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    if (rv != -EAGAIN) {
+        printf("(flag not cleared: read returned %d) ", rv);
         goto out;
     }
-    if (memcmp(buf, "asdf", 4) != 0) {
-        res = 1;
+    sigsafe_fetch_received(&set, counts, NSIG);
+    if (sigismember(&set, SIGALRM) || counts[SIGALRM] != 0) {
+        printf("(not cleared) ");
         goto out;
     }
     res = 0;
 
-  out:
+out:
+    sigsafe_clear_received();
     close(mypipe[0]);
     close(mypipe[1]);
     return res;
 }
 
-struct test {
-    char *name;
-    int (*func)(void);
-} tests[] = {
-#define DECLARE(name) { #name, name }
-    DECLARE(test_received_flag),
-    DECLARE(test_pause), /* 0-argument */
-    DECLARE(test_nanosleep),
-    DECLARE(test_read),  /* 3-argument */
+/**
+ * Tests that the siginfo ring passes <tt>sigqueue()</tt> payloads in order
+ * and counts what doesn't fit.
+ */
+int
+test_siginfo_queue(void)
+{
+    struct sigsafe_siginfo buf[8];
+    unsigned long dropped;
+    union sigval v;
+    int i, n, res = 1;
+
+    error_wrap(sigsafe_install_handler(SIGUSR2, NULL),
+               "sigsafe_install_handler", NEGATIVE);
+    error_wrap(sigsafe_install_siginfo_queue(4),
+               "sigsafe_install_siginfo_queue", NEGATIVE);
+    for (i = 0; i < 6; i++) {
+        v.sival_int = 100 + i;
+        error_wrap(sigqueue(getpid(), SIGUSR2, v), "sigqueue", ERRNO);
+    }
+    sigsafe_clear_received();
+    n = sigsafe_drain_siginfo(buf, 8, &dropped);
+    if (n != 4 || dropped != 2) {
+        printf("(drained %d, dropped %lu) ", n, dropped);
+        goto out;
+    }
+    for (i = 0; i < n; i++) {
+        if (   buf[i].signo != SIGUSR2 || buf[i].code != SI_QUEUE
+            || buf[i].value.sival_int != 100 + i || buf[i].pid != getpid()) {
+            printf("(entry %d: signo %d value %d) ", i, buf[i].signo,
+                   buf[i].value.sival_int);
+            goto out;
+        }
+    }
+    raise(SIGALRM);
+    sigsafe_clear_received();
+    n = sigsafe_drain_siginfo(buf, 8, &dropped);
+    if (n != 1 || dropped != 0 || buf[0].signo != SIGALRM) {
+        printf("(after draining: %d entries, dropped %lu) ", n, dropped);
+        goto out;
+    }
+    res = 0;
+
+out:
+    sigsafe_install_siginfo_queue(0);
+    return res;
+}
+
+static int deferred_signo, deferred_runs;
+static unsigned int deferred_count;
+
+static void
+test_deferred_handler(int signo, unsigned int count, intptr_t user_data)
+{
+    if (user_data != (intptr_t) &tsd) {
+        abort();
+    }
+    deferred_signo = signo;
+    deferred_count = count;
+    deferred_runs++;
+}
+
+/**
+ * Tests that a deferred handler runs only from sigsafe_dispatch_pending(),
+ * once per batch of signals, and leaves other signals to
+ * sigsafe_fetch_received().
+ */
+int
+test_deferred(void)
+{
+    unsigned int counts[NSIG];
+    sigset_t set;
+    int n, res = 1;
+
+    error_wrap(sigsafe_install_deferred_handler(SIGUSR2,
+                                                test_deferred_handler),
+               "sigsafe_install_deferred_handler", NEGATIVE);
+    sigsafe_fetch_received(NULL, NULL, 0);
+    deferred_runs = 0;
+    raise(SIGUSR2);
+    raise(SIGALRM);
+    raise(SIGUSR2);
+    if (deferred_runs != 0) {
+        printf("(ran in signal context) ");
+        goto out;
+    }
+    sigsafe_clear_received();
+    n = sigsafe_dispatch_pending();
+    if (n != 1 || deferred_runs != 1 || deferred_signo != SIGUSR2
+        || deferred_count != 2) {
+        printf("(dispatched %d: %d runs, signo %d, count %u) ", n,
+               deferred_runs, deferred_signo, deferred_count);
+        goto out;
+    }
+    if (sigsafe_dispatch_pending() != 0) {
+        printf("(ran twice) ");
+        goto out;
+    }
+    sigsafe_fetch_received(&set, counts, NSIG);
+    if (   !sigismember(&set, SIGALRM) || counts[SIGALRM] != 1
+        || sigismember(&set, SIGUSR2)) {
+        printf("(left SIGALRM %d, SIGUSR2 %d) ", sigismember(&set, SIGALRM),
+               sigismember(&set, SIGUSR2));
+        goto out;
+    }
+    res = 0;
+
+out:
+    sigsafe_install_handler(SIGUSR2, NULL);
+    sigsafe_clear_received();
+    return res;
+}
+
+#ifdef SIGSAFE_HAVE_INTERRUPT
+#ifdef _THREAD_SAFE
+static sigsafe_thread_t interrupt_subthread_handle;
+static volatile int interrupt_subthread_ready;
+
+static void*
+test_interrupt_subthread(void *arg)
+{
+    int fd = *(int*) arg;
+    char c;
+
+    error_wrap(sigsafe_install_tsd(0, NULL), "sigsafe_install_tsd", NEGATIVE);
+    interrupt_subthread_handle = sigsafe_thread_self();
+    interrupt_subthread_ready = 1;
+    return (void*) (intptr_t) sigsafe_read(fd, &c, 1);
+}
+#endif
+
+/**
+ * Tests sigsafe_interrupt_thread() and sigsafe_interrupt_all(): the target's
+ * sigsafe call returns <tt>-EINTR</tt>, and an exited thread is gone from
+ * the registry.
+ */
+int
+test_interrupt(void)
+{
+#ifdef _THREAD_SAFE
+    pthread_t subthread;
+    void *vres;
+#endif
+    int mypipe[2];
+    char c;
+    int rv, res = 1;
+
+    error_wrap(sigsafe_install_interrupt_handler(SIGRTMIN + 1),
+               "sigsafe_install_interrupt_handler", NEGATIVE);
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+
+#ifdef _THREAD_SAFE
+    interrupt_subthread_ready = 0;
+    error_wrap(pthread_create(&subthread, NULL, test_interrupt_subthread,
+                              &mypipe[0]),
+               "pthread_create", DIRECT);
+    while (!interrupt_subthread_ready) {
+        sched_yield();
+    }
+    rv = sigsafe_interrupt_all();
+    sigsafe_clear_received();
+    error_wrap(pthread_join(subthread, &vres), "pthread_join", DIRECT);
+    if (rv < 2 || (intptr_t) vres != -EINTR) {
+        printf("(interrupt_all returned %d; subthread's read %d) ", rv,
+               (int) (intptr_t) vres);
+        goto out;
+    }
+    rv = sigsafe_interrupt_thread(interrupt_subthread_handle);
+    if (rv != -ESRCH) {
+        printf("(exited thread: returned %d) ", rv);
+        goto out;
+    }
+#endif
+
+    error_wrap(sigsafe_interrupt_thread(sigsafe_thread_self()),
+               "sigsafe_interrupt_thread", NEGATIVE);
+    fcntl(mypipe[0], F_SETFL, O_NONBLOCK);
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    sigsafe_clear_received();
+    if (rv != -EINTR) {
+        printf("(self: read returned %d) ", rv);
+        goto out;
+    }
+    res = 0;
+
+out:
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+
+#ifdef _THREAD_SAFE
+static volatile int route_subthread_ready;
+
+static void*
+test_route_subthread(void *arg)
+{
+    int fd = *(int*) arg;
+    char c;
+
+    error_wrap(sigsafe_install_tsd(0, NULL), "sigsafe_install_tsd", NEGATIVE);
+    error_wrap(sigsafe_own_signal(SIGRTMIN + 2, 1), "sigsafe_own_signal",
+               NEGATIVE);
+    route_subthread_ready = 1;
+    return (void*) (intptr_t) sigsafe_read(fd, &c, 1);
+}
+#endif
+
+/**
+ * Tests sigsafe_route_signal(): a process-directed signal landing on a
+ * thread that doesn't own it wakes the owner instead; a thread-directed
+ * one stays put.
+ */
+int
+test_route(void)
+{
+    int signum = SIGRTMIN + 2;
+#ifdef _THREAD_SAFE
+    pthread_t subthread;
+    void *vres;
+    int mypipe[2];
+#endif
+    sigset_t set;
+    int res = 1;
+
+    error_wrap(sigsafe_install_handler(signum, NULL),
+               "sigsafe_install_handler", NEGATIVE);
+    error_wrap(sigsafe_route_signal(signum, SIGSAFE_ROUTE_ONE),
+               "sigsafe_route_signal", NEGATIVE);
+    sigsafe_fetch_received(NULL, NULL, 0);
+
+#ifdef _THREAD_SAFE
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    route_subthread_ready = 0;
+    error_wrap(pthread_create(&subthread, NULL, test_route_subthread,
+                              &mypipe[0]),
+               "pthread_create", DIRECT);
+    while (!route_subthread_ready) {
+        sched_yield();
+    }
+    kill(getpid(), signum);
+    error_wrap(pthread_join(subthread, &vres), "pthread_join", DIRECT);
+    close(mypipe[0]);
+    close(mypipe[1]);
+    sigsafe_fetch_received(&set, NULL, 0);
+    if ((intptr_t) vres != -EINTR || sigismember(&set, signum)) {
+        printf("(owner's read %d; here %d) ", (int) (intptr_t) vres,
+               sigismember(&set, signum));
+        goto out;
+    }
+#endif
+
+    /* With no owner left, it's handled where it lands. */
+    kill(getpid(), signum);
+    sigsafe_fetch_received(&set, NULL, 0);
+    if (!sigismember(&set, signum)) {
+        printf("(unowned: not received) ");
+        goto out;
+    }
+    res = 0;
+
+out:
+    sigsafe_route_signal(signum, SIGSAFE_ROUTE_NONE);
+    return res;
+}
+
+#ifdef _THREAD_SAFE
+struct pool_test {
+    int fd;
+    volatile int started;
+    int rv;
+    int cancelled;
+};
+
+static void
+pool_test_count(void *arg)
+{
+    __sync_fetch_and_add((volatile int*) arg, 1);
+}
+
+static void
+pool_test_read(void *arg)
+{
+    struct pool_test *t = (struct pool_test*) arg;
+    char c;
+
+    t->started = 1;
+    t->rv = sigsafe_read(t->fd, &c, 1);
+    t->cancelled = sigsafe_pool_cancelled();
+}
+#endif
+
+/**
+ * Tests the pool: tasks run and can be waited for; cancelling a running task
+ * interrupts its blocking call and the next task starts with a clean flag;
+ * a task cancelled while queued never runs; a finished one can't be
+ * cancelled.
+ */
+int
+test_pool(void)
+{
+#ifdef _THREAD_SAFE
+    struct sigsafe_task tasks[100], blocked, dropped, after;
+    struct pool_test blocked_arg, dropped_arg, after_arg;
+    volatile int count = 0;
+    int mypipe[2];
+    int i, rv, res = 1;
+#endif
+    struct sigsafe_pool *pool;
+
+    error_wrap(sigsafe_install_interrupt_handler(SIGRTMIN + 1),
+               "sigsafe_install_interrupt_handler", NEGATIVE);
+#ifndef _THREAD_SAFE
+    return (sigsafe_pool_create(&pool, 1) == -ENOSYS) ? 0 : 1;
+#else
+    /* One worker, so every task here runs on the same thread. */
+    error_wrap(sigsafe_pool_create(&pool, 1), "sigsafe_pool_create",
+               NEGATIVE);
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    fcntl(mypipe[0], F_SETFL, O_NONBLOCK);
+
+    for (i = 0; i < 100; i++) {
+        sigsafe_pool_submit(pool, &tasks[i], pool_test_count, (void*) &count);
+    }
+    for (i = 0; i < 100; i++) {
+        rv = sigsafe_pool_wait(&tasks[i]);
+        if (rv != 0) {
+            printf("(task %d: wait returned %d) ", i, rv);
+            goto out;
+        }
+    }
+    if (count != 100) {
+        printf("(%d of 100 tasks ran) ", count);
+        goto out;
+    }
+
+    memset(&blocked_arg, 0, sizeof(blocked_arg));
+    memset(&dropped_arg, 0, sizeof(dropped_arg));
+    memset(&after_arg, 0, sizeof(after_arg));
+    blocked_arg.fd = dropped_arg.fd = after_arg.fd = mypipe[0];
+    fcntl(mypipe[0], F_SETFL, 0);
+    sigsafe_pool_submit(pool, &blocked, pool_test_read, &blocked_arg);
+    while (!blocked_arg.started) {
+        sched_yield();
+    }
+    fcntl(mypipe[0], F_SETFL, O_NONBLOCK); /* for the later tasks */
+    sigsafe_pool_submit(pool, &dropped, pool_test_read, &dropped_arg);
+    error_wrap(sigsafe_pool_cancel(&dropped), "sigsafe_pool_cancel",
+               NEGATIVE);
+    error_wrap(sigsafe_pool_cancel(&blocked), "sigsafe_pool_cancel",
+               NEGATIVE);
+    rv = sigsafe_pool_wait(&blocked);
+    if (rv != -ECANCELED || blocked_arg.rv != -EINTR
+        || !blocked_arg.cancelled) {
+        printf("(running: wait %d, read %d, cancelled %d) ", rv,
+               blocked_arg.rv, blocked_arg.cancelled);
+        goto out;
+    }
+    rv = sigsafe_pool_wait(&dropped);
+    if (rv != -ECANCELED || dropped_arg.started) {
+        printf("(queued: wait %d, started %d) ", rv, dropped_arg.started);
+        goto out;
+    }
+
+    sigsafe_pool_submit(pool, &after, pool_test_read, &after_arg);
+    rv = sigsafe_pool_wait(&after);
+    if (rv != 0 || after_arg.rv != -EAGAIN || after_arg.cancelled) {
+        printf("(after: wait %d, read %d) ", rv, after_arg.rv);
+        goto out;
+    }
+    rv = sigsafe_pool_cancel(&after);
+    if (rv != -ESRCH) {
+        printf("(finished: cancel returned %d) ", rv);
+        goto out;
+    }
+    res = 0;
+
+out:
+    sigsafe_pool_destroy(pool);
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+#endif
+}
+
+/**
+ * Tests the watchdog: a read blocked past an armed timeout returns
+ * <tt>-EINTR</tt> and disarm reports it fired, once; a timeout disarmed in
+ * time does not fire.
+ */
+int
+test_watchdog(void)
+{
+    struct timespec tick = { 0, 1000000 };
+    struct timespec timeout = { 0, 5000000 };
+    struct timespec forever = { 10, 0 };
+    int mypipe[2];
+    char c;
+    int rv, res = 1;
+
+    error_wrap(sigsafe_install_interrupt_handler(SIGRTMIN + 1),
+               "sigsafe_install_interrupt_handler", NEGATIVE);
+    rv = sigsafe_watchdog_start(&tick);
+#ifdef _THREAD_SAFE
+    error_wrap(rv, "sigsafe_watchdog_start", NEGATIVE);
+#else
+    return (rv == -ENOSYS) ? 0 : 1;
+#endif
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+
+    sigsafe_watchdog_arm(&timeout);
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    if (rv != -EINTR || sigsafe_watchdog_disarm() != 1) {
+        printf("(timed out read returned %d) ", rv);
+        goto out;
+    }
+    sigsafe_clear_received();
+    if (sigsafe_watchdog_disarm() != 0) {
+        printf("(second disarm reported the fire again) ");
+        goto out;
+    }
+
+    sigsafe_watchdog_arm(&forever);
+    error_wrap(write(mypipe[1], "x", 1), "write", ERRNO);
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    if (rv != 1 || sigsafe_watchdog_disarm() != 0) {
+        printf("(timely read returned %d) ", rv);
+        goto out;
+    }
+    res = 0;
+
+out:
+    sigsafe_watchdog_stop();
+    sigsafe_clear_received();
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_DEADLINE
+static void
+deadline_in(struct timespec *ts, long ns)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_nsec += ns;
+    while (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * Tests sigsafe_set_deadline(): a read blocked past the deadline returns
+ * <tt>-EINTR</tt> with the deadline marked expired, and a timer signal left
+ * over from a deadline that has since been moved is ignored.
+ */
+int
+test_deadline(void)
+{
+    struct timespec deadline, ts = { .tv_sec = 0, .tv_nsec = 3000000 };
+    sigset_t set, oldset;
+    int mypipe[2];
+    char c;
+    int rv, res = 1;
+
+    error_wrap(sigsafe_install_deadline_handler(SIGUSR2),
+               "sigsafe_install_deadline_handler", NEGATIVE);
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+
+    deadline_in(&deadline, 1000000);
+    error_wrap(sigsafe_set_deadline(&deadline), "sigsafe_set_deadline",
+               NEGATIVE);
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    if (rv != -EINTR || !sigsafe_deadline_expired()) {
+        printf("(read returned %d, expired %d) ", rv,
+               sigsafe_deadline_expired());
+        goto out;
+    }
+    sigsafe_clear_received();
+
+    /* Let the timer fire while blocked, then move the deadline. */
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &set, &oldset);
+    deadline_in(&deadline, 1000000);
+    error_wrap(sigsafe_set_deadline(&deadline), "sigsafe_set_deadline",
+               NEGATIVE);
+    nanosleep(&ts, NULL);
+    deadline_in(&deadline, 10000000000LL);
+    error_wrap(sigsafe_set_deadline(&deadline), "sigsafe_set_deadline",
+               NEGATIVE);
+    sigprocmask(SIG_SETMASK, &oldset, NULL);
+    fcntl(mypipe[0], F_SETFL, O_NONBLOCK);
+    rv = sigsafe_read(mypipe[0], &c, 1);
+    if (rv != -EAGAIN || sigsafe_deadline_expired()) {
+        printf("(stale: read returned %d, expired %d) ", rv,
+               sigsafe_deadline_expired());
+        sigsafe_clear_received();
+        goto out;
+    }
+    res = 0;
+
+out:
+    sigsafe_set_deadline(NULL);
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+#endif
+
+void
+test_userhandler_handler(int signo, siginfo_t *si, ucontext_t *ctx,
+                         intptr_t user_data)
+{
+    sig_atomic_t volatile *tsd = (sig_atomic_t volatile *) user_data;
+
+    if (*tsd != 26) {
+        abort();
+    }
+    *tsd = 37;
+}
+
+/**
+ * Tests that the userhandler is invoked with the correct info.
+ */
+int
+test_userhandler(void)
+{
+    sigsafe_install_handler(SIGUSR1, test_userhandler_handler);
+    tsd = 26;
+    raise(SIGUSR1);
+    sigsafe_clear_received();
+    if (tsd != 37) {
+        return 1;
+    }
+
+    return 0;
+}
+
+#ifdef _THREAD_SAFE
+#define MAGIC_INIT          73
+#define MAGIC_BEFORESIG     26
+#define MAGIC_SIG           37
+#define MAGIC_AFTERSIG      17
+#define MAGIC_DESTRUCTOR    42
+
+static void
+test_tsd_usr1(int signo, siginfo_t *si, ucontext_t *ctx, intptr_t user_data)
+{
+    sig_atomic_t volatile *subthread_tsd = (sig_atomic_t volatile *) user_data;
+
+    if (*subthread_tsd != MAGIC_BEFORESIG) {
+        abort();
+    }
+    *subthread_tsd = MAGIC_SIG;
+}
+
+static void
+subthread_tsd_destructor(intptr_t tsd)
+{
+    sig_atomic_t volatile *subthread_tsd = (sig_atomic_t volatile *) tsd;
+
+    if (*subthread_tsd != MAGIC_AFTERSIG) {
+        abort();
+    }
+    *subthread_tsd = MAGIC_DESTRUCTOR;
+}
+
+static void*
+test_tsd_subthread(void *arg)
+{
+    sig_atomic_t volatile *subthread_tsd = (sig_atomic_t volatile *) arg;
+
+    error_wrap(sigsafe_install_tsd((intptr_t) subthread_tsd,
+                                   subthread_tsd_destructor),
+               "sigsafe_install_tsd", NEGATIVE);
+
+    if (*subthread_tsd != MAGIC_INIT) {
+        return (void*) 1;
+    }
+    *subthread_tsd = MAGIC_BEFORESIG;
+    error_wrap(sigsafe_install_handler(SIGUSR1, test_tsd_usr1),
+               "sigsafe_install_handler", NEGATIVE);
+    pthread_kill(pthread_self(), SIGUSR1);
+    /*
+     * Note: never clearing received.
+     * This should not affect the main thread.
+     */
+    if (*subthread_tsd != MAGIC_SIG) {
+        return (void*) 1;
+    }
+    *subthread_tsd = MAGIC_AFTERSIG;
+
+    return (void*) 0;
+}
+
+int
+test_tsd(void)
+{
+    pthread_t subthread;
+    sig_atomic_t volatile subthread_tsd = MAGIC_INIT;
+    void *vres;
+    int ires;
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1 };
+
+    tsd = 0;
+
+    error_wrap(pthread_create(&subthread, NULL, test_tsd_subthread,
+                              (void*) &subthread_tsd),
+               "pthread_create", DIRECT);
+    error_wrap(pthread_join(subthread, &vres),
+               "pthread_join", DIRECT);
+    if (vres != 0) {
+        printf("(subthread failed) ");
+        return 1;
+    }
+    if (subthread_tsd != MAGIC_DESTRUCTOR) {
+        printf("(destructor didn't run; subthread_tsd=*%p=%d tsd=*%p=%d) ",
+               &subthread_tsd, subthread_tsd, &tsd, tsd);
+        return 1;
+    }
+
+    /* Subthread's flag shouldn't be honored here. */
+    ires = sigsafe_nanosleep(&ts, NULL);
+    if (ires != 0) {
+        printf("(sigsafe_nanosleep failed) ");
+        return 1;
+    }
+
+    return 0;
+}
+#undef MAGIC_INIT
+#undef MAGIC_BEFORESIG
+#undef MAGIC_SIG
+#undef MAGIC_AFTERSIG
+#undef MAGIC_DESTRUCTOR
+#endif
+
+/* Tests that sigsafe_read() works. */
+int
+test_read(void)
+{
+    int mypipe[2];
+    int res;
+    REGISTERS_DECLARATION;
+    char buf[4];
+
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    res = write(mypipe[1], "asdf", 4); /* <PIPE_BUF; complete without block */
+    if (res != 4) {
+        printf("(setup failure) ");
+        res = 1;
+        goto out;
+    }
+
+    REGISTERS_PRE;
+    res = sigsafe_read(mypipe[0], buf, 4);
+    if (REGISTERS_WRONG) {
+        printf("(bad registers) ");
+        res = 1;
+        goto out;
+    }
+    if (res != 4) {
+        printf("(returned %d) ", res);
+        res = 1;
+        goto out;
+    }
+    if (memcmp(buf, "asdf", 4) != 0) {
+        res = 1;
+        goto out;
+    }
+    res = 0;
+
+  out:
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+
+/**
+ * Tests sigsafe_read_inline(): an ordinary read, a signal noted beforehand,
+ * and a signal arriving while blocked in the kernel, which only returns
+ * <tt>-EINTR</tt> if the handler found the inline site's jump region.
+ */
+int
+test_read_inline(void)
+{
+    struct itimerval it = {
+        .it_interval = { .tv_sec = 0, .tv_usec = 0 },
+        .it_value = { .tv_sec = 0, .tv_usec = 500 }
+    };
+    int mypipe[2];
+    int res;
+    char buf[4];
+
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    if (write(mypipe[1], "asdf", 4) != 4) {
+        printf("(setup failure) ");
+        res = 1;
+        goto out;
+    }
+    res = sigsafe_read_inline(mypipe[0], buf, 4);
+    if (res != 4 || memcmp(buf, "asdf", 4) != 0) {
+        printf("(returned %d) ", res);
+        res = 1;
+        goto out;
+    }
+
+    raise(SIGALRM);
+    res = sigsafe_read_inline(mypipe[0], buf, 4);
+    sigsafe_clear_received();
+    if (res != -EINTR) {
+        printf("(early signal: returned %d) ", res);
+        res = 1;
+        goto out;
+    }
+
+    error_wrap(setitimer(ITIMER_REAL, &it, NULL), "setitimer", ERRNO);
+    res = sigsafe_read_inline(mypipe[0], buf, 4);
+    sigsafe_clear_received();
+    if (res != -EINTR) {
+        printf("(blocked: returned %d) ", res);
+        res = 1;
+        goto out;
+    }
+    res = 0;
+
+  out:
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+
+#ifdef SIGSAFE_HAVE_SYSCALL
+/**
+ * Tests sigsafe_syscall() with zero, three, and six arguments, and that it
+ * returns <tt>-EINTR</tt> both for an early signal and for one that arrives
+ * while blocked in the kernel.
+ */
+int
+test_syscall(void)
+{
+    struct itimerval it = {
+        .it_interval = { .tv_sec = 0, .tv_usec = 0 },
+        .it_value = { .tv_sec = 0, .tv_usec = 500 }
+    };
+    long pagesize = sysconf(_SC_PAGESIZE);
+    int mypipe[2];
+    long res;
+    char buf[4];
+    char *p;
+    FILE *tmp;
+    REGISTERS_DECLARATION;
+
+    if (sigsafe_syscall(SYS_getpid) != getpid()) {
+        printf("(getpid) ");
+        return 1;
+    }
+
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    if (write(mypipe[1], "asdf", 4) != 4) {
+        printf("(setup failure) ");
+        res = 1;
+        goto out;
+    }
+    REGISTERS_PRE;
+    res = sigsafe_syscall(SYS_read, mypipe[0], buf, 4);
+    if (REGISTERS_WRONG) {
+        printf("(bad registers) ");
+        res = 1;
+        goto out;
+    }
+    if (res != 4 || memcmp(buf, "asdf", 4) != 0) {
+        printf("(read returned %ld) ", res);
+        res = 1;
+        goto out;
+    }
+
+    raise(SIGALRM);
+    res = sigsafe_syscall(SYS_read, mypipe[0], buf, 4);
+    sigsafe_clear_received();
+    if (res != -EINTR) {
+        printf("(early signal: returned %ld) ", res);
+        res = 1;
+        goto out;
+    }
+
+    error_wrap(setitimer(ITIMER_REAL, &it, NULL), "setitimer", ERRNO);
+    res = sigsafe_syscall(SYS_read, mypipe[0], buf, 4);
+    sigsafe_clear_received();
+    if (res != -EINTR) {
+        printf("(blocked: returned %ld) ", res);
+        res = 1;
+        goto out;
+    }
+
+    /* The sixth argument (the offset) must make it to the kernel. */
+    tmp = tmpfile();
+    if (tmp == NULL || fseek(tmp, pagesize, SEEK_SET) != 0
+        || fputc('x', tmp) == EOF || fflush(tmp) != 0) {
+        printf("(setup failure) ");
+        res = 1;
+        goto out;
+    }
+#ifdef SYS_mmap2
+    res = sigsafe_syscall(SYS_mmap2, NULL, pagesize, PROT_READ, MAP_PRIVATE,
+                          fileno(tmp), 1);
+#else
+    res = sigsafe_syscall(SYS_mmap, NULL, pagesize, PROT_READ, MAP_PRIVATE,
+                          fileno(tmp), pagesize);
+#endif
+    fclose(tmp);
+    if (res < 0 && res > -4096) {
+        printf("(mmap returned %ld) ", res);
+        res = 1;
+        goto out;
+    }
+    p = (char*) res;
+    res = (p[0] == 'x') ? 0 : 1;
+    munmap(p, pagesize);
+
+  out:
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+
+/**
+ * Tests sigsafe_batch(): it runs every op in order, stops after one that
+ * fails, and stops before entering the next one once a signal arrives.
+ */
+int
+test_batch(void)
+{
+    struct sigsafe_op ops[3];
+    int mypipe[2];
+    char buf[4];
+    int rv, res = 1;
+    REGISTERS_DECLARATION;
+
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    memset(ops, 0, sizeof(ops));
+    ops[0].number = SYS_write;
+    ops[0].args[0] = mypipe[1];
+    ops[0].args[1] = (long) "asdf";
+    ops[0].args[2] = 4;
+    ops[1].number = SYS_read;
+    ops[1].args[0] = mypipe[0];
+    ops[1].args[1] = (long) buf;
+    ops[1].args[2] = 4;
+    ops[2].number = SYS_getpid;
+
+    REGISTERS_PRE;
+    rv = sigsafe_batch(ops, 3);
+    if (REGISTERS_WRONG) {
+        printf("(bad registers) ");
+        goto out;
+    }
+    if (rv != 3 || ops[0].result != 4 || ops[1].result != 4
+        || memcmp(buf, "asdf", 4) != 0 || ops[2].result != getpid()) {
+        printf("(all: returned %d) ", rv);
+        goto out;
+    }
+
+    ops[0].args[0] = -1;
+    rv = sigsafe_batch(ops, 3);
+    if (rv != 1 || ops[0].result != -EBADF) {
+        printf("(failure: returned %d, %ld) ", rv, ops[0].result);
+        goto out;
+    }
+
+    ops[0].args[0] = mypipe[1];
+    raise(SIGALRM);
+    rv = sigsafe_batch(ops, 3);
+    sigsafe_clear_received();
+    if (rv != 0 || ops[0].result != -EINTR) {
+        printf("(early signal: returned %d) ", rv);
+        goto out;
+    }
+    res = 0;
+
+out:
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_INTERRUPTIBLE
+static volatile unsigned long spin_count;
+
+static void SIGSAFE_INTERRUPTIBLE
+spin(void *arg)
+{
+    unsigned long limit = *(unsigned long*) arg;
+
+    while (spin_count < limit) {
+        spin_count++;
+    }
+}
+
+/**
+ * Tests sigsafe_run_interruptible(): a short loop runs to completion, and a
+ * loop that would never end is abandoned when a signal arrives, as is one
+ * started after a signal.
+ */
+int
+test_interruptible(void)
+{
+    struct itimerval it = {
+        .it_interval = { .tv_sec = 0, .tv_usec = 0 },
+        .it_value = { .tv_sec = 0, .tv_usec = 1000 }
+    };
+    unsigned long limit;
+    int rv;
+
+    spin_count = 0;
+    limit = 1000;
+    rv = sigsafe_run_interruptible(spin, &limit);
+    if (rv != 0 || spin_count != limit) {
+        printf("(short: returned %d after %lu) ", rv, spin_count);
+        return 1;
+    }
+
+    spin_count = 0;
+    limit = (unsigned long) -1;
+    error_wrap(setitimer(ITIMER_REAL, &it, NULL), "setitimer", ERRNO);
+    rv = sigsafe_run_interruptible(spin, &limit);
+    sigsafe_clear_received();
+    if (rv != -EINTR || spin_count == 0) {
+        printf("(endless: returned %d after %lu) ", rv, spin_count);
+        return 1;
+    }
+
+    spin_count = 0;
+    raise(SIGALRM);
+    rv = sigsafe_run_interruptible(spin, &limit);
+    sigsafe_clear_received();
+    if (rv != -EINTR || spin_count != 0) {
+        printf("(early: returned %d after %lu) ", rv, spin_count);
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_PREAD
+/**
+ * Tests the positional I/O calls, including an offset past 4 GiB (which
+ * the i386 port passes to the kernel in two registers).
+ */
+int
+test_pread(void)
+{
+    const loff_t big = ((loff_t) 1 << 32) + 5;
+    char buf[4];
+    FILE *tmp;
+    int fd;
+    long res;
+#ifdef SIGSAFE_HAVE_PREADV
+    struct iovec iov[2];
+#endif
+    REGISTERS_DECLARATION;
+
+    tmp = tmpfile();
+    if (tmp == NULL) {
+        printf("(setup failure) ");
+        return 1;
+    }
+    fd = fileno(tmp);
+    if (write(fd, "0123456789", 10) != 10) {
+        printf("(setup failure) ");
+        res = 1;
+        goto out;
+    }
+
+    REGISTERS_PRE;
+    res = sigsafe_pread(fd, buf, 3, 5);
+    if (REGISTERS_WRONG) {
+        printf("(bad registers) ");
+        res = 1;
+        goto out;
+    }
+    if (res != 3 || memcmp(buf, "567", 3) != 0) {
+        printf("(pread returned %ld) ", res);
+        res = 1;
+        goto out;
+    }
+    if (sigsafe_pwrite(fd, "abcd", 4, big) != 4
+        || sigsafe_pread(fd, buf, 4, big) != 4
+        || memcmp(buf, "abcd", 4) != 0) {
+        printf("(large offset) ");
+        res = 1;
+        goto out;
+    }
+
+    raise(SIGALRM);
+    res = sigsafe_pread(fd, buf, 3, 5);
+    sigsafe_clear_received();
+    if (res != -EINTR) {
+        printf("(early signal: returned %ld) ", res);
+        res = 1;
+        goto out;
+    }
+
+#ifdef SIGSAFE_HAVE_PREADV
+    iov[0].iov_base = &buf[0];
+    iov[0].iov_len = 1;
+    iov[1].iov_base = &buf[1];
+    iov[1].iov_len = 2;
+    res = sigsafe_preadv(fd, iov, 2, 1);
+    if (res != 3 || memcmp(buf, "123", 3) != 0) {
+        printf("(preadv returned %ld) ", res);
+        res = 1;
+        goto out;
+    }
+    if (sigsafe_pwritev(fd, iov, 2, big + 1) != 3
+        || sigsafe_pread(fd, buf, 4, big) != 4
+        || memcmp(buf, "a123", 4) != 0) {
+        printf("(pwritev) ");
+        res = 1;
+        goto out;
+    }
+#endif
+
+#ifdef SIGSAFE_HAVE_PREADV2
+    /* RWF_NOWAIT may be unsupported here, or the data may not be cached. */
+    res = sigsafe_preadv2(fd, iov, 2, 7, RWF_NOWAIT);
+    if (res != -ENOSYS && res != -EOPNOTSUPP && res != -EAGAIN
+        && (res != 3 || memcmp(buf, "789", 3) != 0)) {
+        printf("(preadv2 returned %ld) ", res);
+        res = 1;
+        goto out;
+    }
+    res = sigsafe_pwritev2(fd, iov, 2, 0, 0);
+    if (res != -ENOSYS && res != 3) {
+        printf("(pwritev2 returned %ld) ", res);
+        res = 1;
+        goto out;
+    }
+#endif
+    res = 0;
+
+  out:
+    fclose(tmp);
+    return res;
+}
+#endif
+
+#if defined(SIGSAFE_HAVE_PPOLL) && defined(SIGSAFE_HAVE_PSELECT) \
+    && defined(SIGSAFE_HAVE_EPOLL_PWAIT2)
+static int ptimed_fd, ptimed_epfd;
+
+static int
+ptimed_ppoll(const struct timespec *timeout)
+{
+    struct pollfd pfd = { .fd = ptimed_fd, .events = POLLIN };
+    return sigsafe_ppoll(&pfd, 1, timeout);
+}
+
+static int
+ptimed_pselect(const struct timespec *timeout)
+{
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(ptimed_fd, &readfds);
+    return sigsafe_pselect(ptimed_fd + 1, &readfds, NULL, NULL, timeout);
+}
+
+static int
+ptimed_epoll_pwait2(const struct timespec *timeout)
+{
+    struct epoll_event ev;
+    return sigsafe_epoll_pwait2(ptimed_epfd, &ev, 1, timeout);
+}
+
+/**
+ * Tests sigsafe_ppoll(), sigsafe_pselect(), and sigsafe_epoll_pwait2() on a
+ * pipe that never becomes readable: early and blocked signals both return
+ * <tt>-EINTR</tt>, and a short timeout returns 0 without being modified.
+ */
+int
+test_ptimed(void)
+{
+    static const struct {
+        const char *name;
+        int (*wait)(const struct timespec *);
+    } waits[] = {
+        { "ppoll",          ptimed_ppoll },
+        { "pselect",        ptimed_pselect },
+        { "epoll_pwait2",   ptimed_epoll_pwait2 },
+    };
+    struct itimerval it = {
+        .it_interval = { .tv_sec = 0, .tv_usec = 0 },
+        .it_value = { .tv_sec = 0, .tv_usec = 500 }
+    };
+    struct epoll_event ev;
+    struct timespec ts;
+    int mypipe[2];
+    int i, res = 0;
+
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    ptimed_fd = mypipe[0];
+    ptimed_epfd = error_wrap(epoll_create(1), "epoll_create", ERRNO);
+    ev.events = EPOLLIN;
+    ev.data.fd = ptimed_fd;
+    error_wrap(epoll_ctl(ptimed_epfd, EPOLL_CTL_ADD, ptimed_fd, &ev),
+               "epoll_ctl", ERRNO);
+
+    for (i = 0; i < sizeof(waits)/sizeof(waits[0]) && res == 0; i++) {
+        int rv;
+
+        raise(SIGALRM);
+        rv = waits[i].wait(NULL);
+        sigsafe_clear_received();
+        if (rv != -EINTR) {
+            printf("(%s early: returned %d) ", waits[i].name, rv);
+            res = 1;
+            break;
+        }
+
+        error_wrap(setitimer(ITIMER_REAL, &it, NULL), "setitimer", ERRNO);
+        rv = waits[i].wait(NULL);
+        sigsafe_clear_received();
+        if (rv != -EINTR) {
+            printf("(%s blocked: returned %d) ", waits[i].name, rv);
+            res = 1;
+            break;
+        }
+
+        ts.tv_sec = 0;
+        ts.tv_nsec = 2000000;
+        rv = waits[i].wait(&ts);
+        if (rv != 0 || ts.tv_sec != 0 || ts.tv_nsec != 2000000) {
+            printf("(%s timeout: returned %d) ", waits[i].name, rv);
+            res = 1;
+        }
+    }
+
+    close(ptimed_epfd);
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_IO_URING
+/**
+ * Tests the io_uring helpers: a read completes normally, and a wait for a
+ * completion that never comes returns <tt>-EINTR</tt> on an early signal and
+ * on one that arrives while blocked in the kernel.
+ */
+int
+test_uring(void)
+{
+    struct itimerval it = {
+        .it_interval = { .tv_sec = 0, .tv_usec = 0 },
+        .it_value = { .tv_sec = 0, .tv_usec = 500 }
+    };
+    struct sigsafe_uring ring;
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe cqe;
+    int mypipe[2];
+    char buf[4];
+    int res;
+
+    res = sigsafe_uring_init(&ring, 4);
+    if (res == -ENOSYS || res == -EPERM) {
+        printf("(io_uring unavailable) ");
+        return 0;
+    } else if (res != 0) {
+        printf("(init returned %d) ", res);
+        return 1;
+    }
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+
+    sqe = sigsafe_uring_get_sqe(&ring);
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = mypipe[0];
+    sqe->addr = (unsigned long) buf;
+    sqe->len = sizeof(buf);
+    sqe->off = (unsigned long long) -1;
+    sqe->user_data = 42;
+
+    raise(SIGALRM);
+    res = sigsafe_uring_wait(&ring, &cqe, 1);
+    sigsafe_clear_received();
+    if (res != -EINTR) {
+        printf("(early signal: returned %d) ", res);
+        res = 1;
+        goto out;
+    }
+
+    error_wrap(setitimer(ITIMER_REAL, &it, NULL), "setitimer", ERRNO);
+    res = sigsafe_uring_wait(&ring, &cqe, 1);
+    sigsafe_clear_received();
+    if (res != -EINTR) {
+        printf("(blocked: returned %d) ", res);
+        res = 1;
+        goto out;
+    }
+
+    if (write(mypipe[1], "asdf", 4) != 4) {
+        printf("(setup failure) ");
+        res = 1;
+        goto out;
+    }
+    res = sigsafe_uring_wait(&ring, &cqe, 1);
+    if (res != 1 || cqe.user_data != 42 || cqe.res != 4
+        || memcmp(buf, "asdf", 4) != 0) {
+        printf("(returned %d, res %d) ", res, cqe.res);
+        res = 1;
+        goto out;
+    }
+    res = 0;
+
+  out:
+    sigsafe_uring_destroy(&ring);
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+#endif
+
+#ifdef SIGSAFE_HAVE_SENDFILE
+/**
+ * Tests sigsafe_copy() from a file to a pipe (sendfile) and from a pipe back
+ * to a file (splice), and that an early signal returns <tt>-EINTR</tt> with
+ * no bytes counted.
+ */
+int
+test_copy(void)
+{
+    static const char data[] = "sigsafe_copy test data";
+    char buf[sizeof(data)];
+    FILE *src = NULL, *dst = NULL;
+    int mypipe[2];
+    size_t copied;
+    loff_t off = 0;
+    int res = 1;
+
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    src = tmpfile();
+    dst = tmpfile();
+    if (src == NULL || dst == NULL
+        || write(fileno(src), data, sizeof(data)) != sizeof(data)) {
+        printf("(setup failure) ");
+        goto out;
+    }
+
+    raise(SIGALRM);
+    res = sigsafe_copy(mypipe[1], fileno(src), &off, sizeof(data), &copied);
+    sigsafe_clear_received();
+    if (res != -EINTR || copied != 0 || off != 0) {
+        printf("(early signal: returned %d, copied %lu) ", res,
+               (unsigned long) copied);
+        res = 1;
+        goto out;
+    }
+
+    res = sigsafe_copy(mypipe[1], fileno(src), &off, sizeof(data), &copied);
+    if (res != 0 || copied != sizeof(data) || off != sizeof(data)) {
+        printf("(file to pipe: returned %d, copied %lu) ", res,
+               (unsigned long) copied);
+        res = 1;
+        goto out;
+    }
+
+#ifdef SIGSAFE_HAVE_SPLICE
+    res = sigsafe_copy(fileno(dst), mypipe[0], NULL, sizeof(data), &copied);
+    if (res != 0 || copied != sizeof(data)) {
+        printf("(pipe to file: returned %d, copied %lu) ", res,
+               (unsigned long) copied);
+        res = 1;
+        goto out;
+    }
+    if (pread(fileno(dst), buf, sizeof(buf), 0) != sizeof(buf)) {
+        res = 1;
+        goto out;
+    }
+#else
+    if (read(mypipe[0], buf, sizeof(buf)) != sizeof(buf)) {
+        res = 1;
+        goto out;
+    }
+#endif
+    res = (memcmp(buf, data, sizeof(data)) == 0) ? 0 : 1;
+
+  out:
+    if (src != NULL) {
+        fclose(src);
+    }
+    if (dst != NULL) {
+        fclose(dst);
+    }
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+#endif
+
+struct reactor_test {
+    struct sigsafe_reactor r;
+    struct sigsafe_reactor_fd rfd, wfd;
+    struct sigsafe_reactor_timer timer, cancelled;
+    struct sigsafe_reactor_signal sig;
+    int reads, writes, timers, signals, cancelled_ran;
+    int remove_other;
+};
+
+static void
+reactor_test_read(int fd, int events, void *arg)
+{
+    struct reactor_test *t = (struct reactor_test*) arg;
+    char c;
+
+    if (events == SIGSAFE_REACTOR_READ && read(fd, &c, 1) == 1) {
+        t->reads++;
+    }
+    if (t->remove_other) {
+        sigsafe_reactor_remove_fd(&t->r, &t->wfd);
+    }
+}
+
+static void
+reactor_test_write(int fd, int events, void *arg)
+{
+    struct reactor_test *t = (struct reactor_test*) arg;
+
+    t->writes++;
+    sigsafe_reactor_remove_fd(&t->r, &t->rfd);
+}
+
+static void
+reactor_test_timer(void *arg)
+{
+    struct reactor_test *t = (struct reactor_test*) arg;
+
+    t->timers++;
+    sigsafe_reactor_cancel_timer(&t->r, &t->cancelled);
+    sigsafe_reactor_stop(&t->r);
+}
+
+static void
+reactor_test_cancelled(void *arg)
+{
+    ((struct reactor_test*) arg)->cancelled_ran++;
+}
+
+static void
+reactor_test_signal(int signo, unsigned int count, void *arg)
+{
+    struct reactor_test *t = (struct reactor_test*) arg;
+
+    if (signo == SIGALRM) {
+        t->signals += count;
+    }
+}
+
+/**
+ * Tests the reactor: descriptor callbacks, a signal raised before the wait
+ * cutting it short and becoming a callback, deferred handlers running and
+ * other signals staying pending for the application, timers in deadline
+ * order with cancellation from a callback, and removal of a descriptor
+ * that is ready in the same pass.
+ */
+int
+test_reactor(void)
+{
+    struct reactor_test t;
+    struct timespec soon = { 0, 1000000 }, later = { 0, 2000000 };
+    struct timeval before, after;
+    sigset_t set;
+    int mypipe[2];
+    int rv, res = 1;
+
+    memset(&t, 0, sizeof(t));
+    error_wrap(sigsafe_reactor_init(&t.r), "sigsafe_reactor_init", NEGATIVE);
+    error_wrap(pipe(mypipe), "pipe", ERRNO);
+    error_wrap(sigsafe_reactor_add_fd(&t.r, &t.rfd, mypipe[0],
+                                      SIGSAFE_REACTOR_READ,
+                                      reactor_test_read, &t),
+               "sigsafe_reactor_add_fd", NEGATIVE);
+    sigsafe_reactor_add_signal(&t.r, &t.sig, SIGALRM, reactor_test_signal,
+                               &t);
+
+    write(mypipe[1], "x", 1);
+    rv = sigsafe_reactor_run_once(&t.r, 0);
+    if (rv != 1 || t.reads != 1) {
+        printf("(read: ran %d, %d reads) ", rv, t.reads);
+        goto out;
+    }
+
+    /* Nothing ready and no timers: only the signal can end this wait. */
+    sigsafe_clear_received();
+    raise(SIGALRM);
+    raise(SIGALRM);
+    rv = sigsafe_reactor_run_once(&t.r, 1);
+    if (rv != 1 || t.signals != 2 || sigsafe_signal_pending()) {
+        printf("(signal: ran %d, %d signals) ", rv, t.signals);
+        goto out;
+    }
+
+    /* A signal with no callback is left for the application to fetch... */
+    error_wrap(sigsafe_install_handler(SIGUSR2, NULL),
+               "sigsafe_install_handler", NEGATIVE);
+    raise(SIGUSR2);
+    raise(SIGALRM);
+    rv = sigsafe_reactor_run_once(&t.r, 1);
+    sigsafe_fetch_received(&set, NULL, 0);
+    if (rv != 1 || t.signals != 3 || !sigismember(&set, SIGUSR2)) {
+        printf("(unhandled: ran %d, %d signals, SIGUSR2 %d) ", rv, t.signals,
+               sigismember(&set, SIGUSR2));
+        goto out;
+    }
+
+    /* ...and one with a deferred handler has it run. */
+    deferred_runs = 0;
+    error_wrap(sigsafe_install_deferred_handler(SIGUSR2,
+                                                test_deferred_handler),
+               "sigsafe_install_deferred_handler", NEGATIVE);
+    raise(SIGUSR2);
+    rv = sigsafe_reactor_run_once(&t.r, 1);
+    if (rv != 1 || deferred_runs != 1) {
+        printf("(deferred: ran %d, %d runs) ", rv, deferred_runs);
+        goto out;
+    }
+
+    error_wrap(sigsafe_reactor_add_timer(&t.r, &t.cancelled, &later,
+                                         reactor_test_cancelled, &t),
+               "sigsafe_reactor_add_timer", NEGATIVE);
+    error_wrap(sigsafe_reactor_add_timer(&t.r, &t.timer, &soon,
+                                         reactor_test_timer, &t),
+               "sigsafe_reactor_add_timer", NEGATIVE);
+    gettimeofday(&before, NULL);
+    error_wrap(sigsafe_reactor_run(&t.r), "sigsafe_reactor_run", NEGATIVE);
+    gettimeofday(&after, NULL);
+    if (t.timers != 1 || t.cancelled_ran != 0
+        || (after.tv_sec - before.tv_sec) * 1000000
+           + (after.tv_usec - before.tv_usec) < 900) {
+        printf("(timers: %d ran, %d cancelled ran) ", t.timers,
+               t.cancelled_ran);
+        goto out;
+    }
+
+    /*
+     * Both ends are ready, and each callback removes the other end's, so
+     * whichever runs first, the other mustn't.
+     */
+    write(mypipe[1], "x", 1);
+    t.remove_other = 1;
+    error_wrap(sigsafe_reactor_add_fd(&t.r, &t.wfd, mypipe[1],
+                                      SIGSAFE_REACTOR_WRITE,
+                                      reactor_test_write, &t),
+               "sigsafe_reactor_add_fd", NEGATIVE);
+    rv = sigsafe_reactor_run_once(&t.r, 0);
+    if (rv != 1 || t.writes + t.reads != 2) {
+        printf("(remove: ran %d) ", rv);
+        goto out;
+    }
+    res = 0;
+
+out:
+    sigsafe_install_handler(SIGUSR2, NULL);
+    sigsafe_clear_received();
+    sigsafe_reactor_destroy(&t.r);
+    close(mypipe[0]);
+    close(mypipe[1]);
+    return res;
+}
+
+struct test {
+    char *name;
+    int (*func)(void);
+} tests[] = {
+#define DECLARE(name) { #name, name }
+    DECLARE(test_received_flag),
+    DECLARE(test_signal_pending),
+    DECLARE(test_tsd_static),
+#ifdef SIGSAFE_HAVE_LAZY_TSD
+    DECLARE(test_lazy_tsd),
+    DECLARE(test_lazy_tsd_reserve),
+#endif
+    DECLARE(test_fetch_received),
+    DECLARE(test_siginfo_queue),
+    DECLARE(test_deferred),
+    DECLARE(test_reactor),
+#ifdef SIGSAFE_HAVE_INTERRUPT
+    DECLARE(test_interrupt),
+    DECLARE(test_watchdog),
+    DECLARE(test_route),
+    DECLARE(test_pool),
+#endif
+    DECLARE(test_pause), /* 0-argument */
+    DECLARE(test_nanosleep),
+#ifdef SIGSAFE_HAVE_CLOCK_NANOSLEEP
+    DECLARE(test_clock_nanosleep),
+#endif
+#ifdef SIGSAFE_HAVE_DEADLINE
+    DECLARE(test_deadline),
+#endif
+    DECLARE(test_read),  /* 3-argument */
+    DECLARE(test_read_inline),
+#ifdef SIGSAFE_HAVE_SYSCALL
+    DECLARE(test_syscall),  /* generic */
+    DECLARE(test_batch),
+#endif
+#ifdef SIGSAFE_HAVE_INTERRUPTIBLE
+    DECLARE(test_interruptible),
+#endif
+#ifdef SIGSAFE_HAVE_PREAD
+    DECLARE(test_pread),    /* 64-bit offsets */
+#endif
+#if defined(SIGSAFE_HAVE_PPOLL) && defined(SIGSAFE_HAVE_PSELECT) \
+    && defined(SIGSAFE_HAVE_EPOLL_PWAIT2)
+    DECLARE(test_ptimed),   /* nanosecond timeouts */
+#endif
+#ifdef SIGSAFE_HAVE_IO_URING
+    DECLARE(test_uring),
+#endif
+#ifdef SIGSAFE_HAVE_SENDFILE
+    DECLARE(test_copy),
+#endif
     DECLARE(test_userhandler),
 #ifdef _THREAD_SAFE
     DECLARE(test_tsd),